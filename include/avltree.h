@@ -1,6 +1,7 @@
 #ifndef __FSDYN_AVLTREE__
 #define __FSDYN_AVLTREE__
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -45,6 +46,24 @@ avl_tree_t *make_avl_tree_2(int (*cmp)(const void *key1, const void *key2,
  */
 void destroy_avl_tree(avl_tree_t *tree);
 
+/*
+ * Destroy an avl_tree_t structure a bit at a time so that freeing a
+ * large tree need not stall the caller. Every call destroys at most
+ * max_elements (which must be positive) elements in key order and
+ * takes O(max_elements) time. cb() (if not NULL) is called for every
+ * element before it is destroyed so the keys and values can be freed
+ * in the same pass. Return true once the whole tree has been destroyed
+ * and false if more calls are needed.
+ *
+ * After the first call, the tree may only be passed to
+ * destroy_avl_tree_incrementally(). Pass SIZE_MAX as max_elements to
+ * destroy the tree and its contents in one call.
+ */
+bool destroy_avl_tree_incrementally(avl_tree_t *tree, size_t max_elements,
+                                    void (*cb)(const void *key,
+                                               const void *value, void *arg),
+                                    void *arg);
+
 /*
  * Destroy an orphaned key-value association.
  *
@@ -115,6 +134,26 @@ avl_elem_t *avl_tree_get_first(avl_tree_t *tree);
  */
 avl_elem_t *avl_tree_get_last(avl_tree_t *tree);
 
+/*
+ * Return the element at the given zero-based position in key order, or
+ * NULL if rank is not less than the size of the tree. The returned
+ * element is valid until the tree is modified. The operation takes
+ * O(log n) time.
+ */
+avl_elem_t *avl_tree_get_by_rank(avl_tree_t *tree, size_t rank);
+
+/*
+ * Return the number of elements whose key is less than the given key.
+ * The key need not be in the tree. The operation takes O(log n) time.
+ */
+size_t avl_tree_rank(avl_tree_t *tree, const void *key);
+
+/*
+ * Return the zero-based position of the element in key order. The
+ * operation takes O(log n) time.
+ */
+size_t avl_elem_get_rank(avl_elem_t *element);
+
 /*
  * Return the successor of the given element or NULL if element is the
  * last element. The returned element is valid until the tree is
@@ -144,6 +183,54 @@ avl_elem_t *avl_tree_previous(avl_elem_t *element);
  */
 avl_elem_t *avl_tree_put(avl_tree_t *tree, const void *key, const void *value);
 
+/*
+ * Like avl_tree_put() but start the search from hint, which must be an
+ * element of the tree or NULL. The search climbs from hint as far as
+ * needed to find the subtree in which key belongs and descends from
+ * there. It takes O(log n) comparisons in the worst case, even for a
+ * key next to hint if the climb passes a high ancestor. Inserting a
+ * run of consecutive keys, each with the previous one as the hint,
+ * takes amortized O(1) comparisons per key.
+ */
+avl_elem_t *avl_tree_put_hint(avl_tree_t *tree, avl_elem_t *hint,
+                              const void *key, const void *value);
+
+/*
+ * This opaque datatype remembers the position of the latest insertion
+ * into an AVL tree.
+ */
+typedef struct avl_cursor avl_cursor_t;
+
+/*
+ * Create a cursor for inserting elements into the tree. The cursor must
+ * be destroyed before the tree.
+ */
+avl_cursor_t *make_avl_cursor(avl_tree_t *tree);
+
+/*
+ * Destroy a cursor. The tree is left intact.
+ */
+void destroy_avl_cursor(avl_cursor_t *cursor);
+
+/*
+ * Insert an element like avl_tree_put(), using the element inserted
+ * previously through the cursor as a hint (see avl_tree_put_hint()).
+ * Inserting a run of keys in sorted order takes amortized O(1)
+ * comparisons per element; any single insertion takes O(log n).
+ *
+ * The element inserted last through the cursor must not be removed from
+ * the tree unless avl_cursor_reset() is called before the cursor is
+ * used again.
+ */
+avl_elem_t *avl_cursor_put(avl_cursor_t *cursor, const void *key,
+                           const void *value);
+
+/*
+ * Make the cursor forget its position. The next insertion through the
+ * cursor starts from the root.
+ */
+void avl_cursor_reset(avl_cursor_t *cursor);
+
 /*
  * Detach an element from the tree.
  *
@@ -185,11 +272,99 @@ avl_elem_t *avl_tree_pop_last(avl_tree_t *tree);
  */
 int avl_tree_empty(avl_tree_t *tree);
 
+/*
+ * Fill an empty tree with n elements in O(n) time. The keys must be in
+ * strictly ascending order according to the comparator of the tree.
+ * The value of keys[i] is values[i], or keys[i] itself if values is
+ * NULL. The resulting tree is perfectly balanced.
+ */
+void avl_tree_build_sorted(avl_tree_t *tree, const void *const keys[],
+                           const void *const values[], size_t n);
+
+/*
+ * Like avl_tree_build_sorted() but check the arguments first, which
+ * takes n - 1 comparisons. Return true on success. Return false and set
+ * errno to EEXIST if the tree is not empty or to EINVAL if the keys are
+ * not in strictly ascending order; the tree is left unchanged.
+ */
+bool avl_tree_build_sorted_checked(avl_tree_t *tree, const void *const keys[],
+                                   const void *const values[], size_t n);
+
+/*
+ * Return the number of elements whose keys are greater than or equal to
+ * lo and less than hi. The operation takes O(log n) time.
+ */
+size_t avl_tree_count_range(avl_tree_t *tree, const void *lo, const void *hi);
+
+/*
+ * Remove the elements whose keys are greater than or equal to lo and
+ * less than hi and return their number. Once the tree has been updated,
+ * cb() (if not NULL) is called for every removed element in key order,
+ * after which the element is destroyed. Detaching the range from the
+ * tree takes O(log n) time, and visiting and destroying the k removed
+ * elements takes O(k) time, so the operation takes O(log n + k) time
+ * in total.
+ */
+size_t avl_tree_remove_range(avl_tree_t *tree, const void *lo, const void *hi,
+                             void (*cb)(const void *key, const void *value,
+                                        void *arg),
+                             void *arg);
+
 /*
  * Make a shallow copy of the tree.
  */
 avl_tree_t *avl_tree_copy(avl_tree_t *tree);
 
+/*
+ * Move the elements whose keys are greater than or equal to the given
+ * key into a new tree, which is returned. The new tree uses the
+ * comparator of the original tree. The operation takes O(log n) time.
+ */
+avl_tree_t *avl_tree_split(avl_tree_t *tree, const void *key);
+
+/*
+ * Move all elements of tree2 into tree1, leaving tree2 empty. Every key
+ * in tree1 must be less than every key in tree2, and the trees must
+ * have the same comparator. The operation takes O(log n) time.
+ */
+void avl_tree_join(avl_tree_t *tree1, avl_tree_t *tree2);
+
+/*
+ * The following set operations leave the result in tree1 and tree2
+ * empty. The trees must have the same comparator. Elements dropped from
+ * either tree are destroyed after discard() is called with their key
+ * and value (if discard is not NULL). With m and n the sizes of the
+ * smaller and the larger tree, each operation takes O(m log(n / m + 1))
+ * time.
+ */
+
+/*
+ * Add to tree1 the elements of tree2 whose keys are not in tree1. The
+ * rest of tree2 is dropped.
+ */
+void avl_tree_union(avl_tree_t *tree1, avl_tree_t *tree2,
+                    void (*discard)(const void *key, const void *value,
+                                    void *arg),
+                    void *arg);
+
+/*
+ * Drop from tree1 the elements whose keys are not in tree2. All of tree2
+ * is dropped.
+ */
+void avl_tree_intersection(avl_tree_t *tree1, avl_tree_t *tree2,
+                           void (*discard)(const void *key, const void *value,
+                                           void *arg),
+                           void *arg);
+
+/*
+ * Drop from tree1 the elements whose keys are in tree2. All of tree2 is
+ * dropped.
+ */
+void avl_tree_difference(avl_tree_t *tree1, avl_tree_t *tree2,
+                         void (*discard)(const void *key, const void *value,
+                                         void *arg),
+                         void *arg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,10 +3,28 @@ struct avl_tree {
     void *obj;
     avl_elem_t *root;
     size_t size;
+    /* If not NULL, called whenever the subtree of an element changes,
+     * after its children have been updated. Only insertions and
+     * detachments maintain augmentation; building, copying, splitting,
+     * joining and the set operations do not. */
+    void (*augment)(avl_elem_t *element, void *obj);
 };
 
 struct avl_elem {
     const void *key, *value;
     avl_elem_t *left, *right, *parent;
     int balance;
+    size_t count; /* number of elements in the subtree */
 };
+
+struct avl_cursor {
+    avl_tree_t *tree;
+    avl_elem_t *position; /* the latest insertion or NULL */
+};
+
+/* Like avl_tree_put() but return the new element. The element with an
+ * equal key that was replaced (or NULL) is stored in *premoved_element
+ * if premoved_element is not NULL. */
+avl_elem_t *avl_tree_put_element(avl_tree_t *tree, const void *key,
+                                 const void *value,
+                                 avl_elem_t **premoved_element);
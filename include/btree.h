@@ -0,0 +1,173 @@
+#ifndef __FSDYN_BTREE__
+#define __FSDYN_BTREE__
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * B+-trees for C.
+ *
+ * A btree_t is a sorted map like avl_tree_t, but it stores its
+ * key-value pairs in arrays of a few dozen consecutive pairs and links
+ * the arrays in key order. Lookups touch a handful of nodes and ordered
+ * scans walk memory sequentially.
+ */
+
+/*
+ * This opaque datatype represents the B+-tree.
+ */
+typedef struct btree btree_t;
+
+/*
+ * This opaque datatype represents a key-value association in the
+ * B+-tree.
+ */
+typedef struct btree_elem btree_elem_t;
+
+/*
+ * Create a btree_t object.
+ *
+ * The key comparator cmp() return value is as with memcmp().
+ */
+btree_t *make_btree(int (*cmp)(const void *key1, const void *key2));
+
+/*
+ * Create a btree_t object.
+ *
+ * The key comparator cmp() return value is as with memcmp(). The
+ * comparator is given a context argument.
+ */
+btree_t *make_btree_2(int (*cmp)(const void *key1, const void *key2,
+                                 void *obj),
+                      void *obj);
+
+/*
+ * Destroy a btree_t structure. The key and value objects contained in
+ * the tree are left intact.
+ */
+void destroy_btree(btree_t *tree);
+
+/*
+ * Return the number of elements in the tree.
+ */
+size_t btree_size(btree_t *tree);
+
+/*
+ * Return a nonzero value if and only if the tree is empty.
+ */
+int btree_empty(btree_t *tree);
+
+/*
+ * Return the key of the element.
+ */
+const void *btree_elem_get_key(btree_elem_t *element);
+
+/*
+ * Return the value of the element.
+ */
+const void *btree_elem_get_value(btree_elem_t *element);
+
+/*
+ * Retrieve an element based on a key. Return NULL if no matching
+ * element is found. The returned element is valid until the tree is
+ * modified.
+ */
+btree_elem_t *btree_get(btree_t *tree, const void *key);
+
+/*
+ * Get the last element whose key is less than the given key, or NULL if
+ * no such element is found. The returned element is valid until the
+ * tree is modified.
+ */
+btree_elem_t *btree_get_before(btree_t *tree, const void *key);
+
+/*
+ * Get the last element whose key is less than or equal to the given
+ * key, or NULL if no such element is found. The returned element is
+ * valid until the tree is modified.
+ */
+btree_elem_t *btree_get_on_or_before(btree_t *tree, const void *key);
+
+/*
+ * Get the first element whose key is greater than the given key, or
+ * NULL if no such element is found. The returned element is valid until
+ * the tree is modified.
+ */
+btree_elem_t *btree_get_after(btree_t *tree, const void *key);
+
+/*
+ * Get the first element whose key is greater than or equal to the given
+ * key, or NULL if no such element is found. The returned element is
+ * valid until the tree is modified.
+ */
+btree_elem_t *btree_get_on_or_after(btree_t *tree, const void *key);
+
+/*
+ * Return the first element of the tree, or NULL if the tree is empty.
+ * The returned element is valid until the tree is modified.
+ */
+btree_elem_t *btree_get_first(btree_t *tree);
+
+/*
+ * Return the last element of the tree, or NULL if the tree is empty.
+ * The returned element is valid until the tree is modified.
+ */
+btree_elem_t *btree_get_last(btree_t *tree);
+
+/*
+ * Return the successor of the given element or NULL if element is the
+ * last element. The returned element is valid until the tree is
+ * modified.
+ */
+btree_elem_t *btree_next(btree_elem_t *element);
+
+/*
+ * Return the predecessor of the given element or NULL if element is the
+ * first element. The returned element is valid until the tree is
+ * modified.
+ */
+btree_elem_t *btree_previous(btree_elem_t *element);
+
+/*
+ * Associate key with value in the tree. The key must not be altered
+ * while it is in the tree.
+ *
+ * If another element with the same key is already stored in the tree,
+ * it is replaced; its key and value are stored in *pold_key and
+ * *pold_value (if not NULL) and true is returned. Otherwise, false is
+ * returned.
+ */
+bool btree_put(btree_t *tree, const void *key, const void *value,
+               const void **pold_key, const void **pold_value);
+
+/*
+ * Look for an element with a key and remove it from the tree. If the
+ * element is found, store its key and value in *pkey and *pvalue (if
+ * not NULL) and return true. Otherwise, return false.
+ */
+bool btree_pop(btree_t *tree, const void *key, const void **pkey,
+               const void **pvalue);
+
+/*
+ * Remove the first element of the tree. Return false if the tree is
+ * empty. Otherwise, store the key and value of the element in *pkey and
+ * *pvalue (if not NULL) and return true.
+ */
+bool btree_pop_first(btree_t *tree, const void **pkey, const void **pvalue);
+
+/*
+ * Remove the last element of the tree. Return false if the tree is
+ * empty. Otherwise, store the key and value of the element in *pkey and
+ * *pvalue (if not NULL) and return true.
+ */
+bool btree_pop_last(btree_t *tree, const void **pkey, const void **pvalue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
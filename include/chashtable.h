@@ -0,0 +1,94 @@
+#ifndef __FSDYN_CHASHTABLE__
+#define __FSDYN_CHASHTABLE__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Concurrent hash tables for C.
+ *
+ * The hash table is divided into shards by the key hash. Writers lock
+ * the shard they modify. Readers take no locks; a shard has a sequence
+ * counter that writers increment before and after a modification, and
+ * a reader retries its lookup if the counter has changed in the
+ * meanwhile.
+ *
+ * Since readers take no locks, a lookup that runs concurrently with
+ * chash_table_pop() or chash_table_put() may still pass the removed
+ * or replaced key to cmp() and return the replaced value after the
+ * modifying call has returned. The application must not free removed
+ * keys and values until all lookups that may have started before the
+ * removal have finished.
+ */
+
+/*
+ * This opaque datatype represents the concurrent hash table.
+ */
+typedef struct chash_table chash_table_t;
+
+/*
+ * Create a chash_table_t object.
+ *
+ * The capacity and the hash() and cmp() functions are as with
+ * make_hash_table(). The functions are called concurrently from
+ * multiple threads.
+ *
+ * The number of shards is rounded up to a power of two. It should be a
+ * few times larger than the number of threads that modify the table.
+ */
+chash_table_t *make_chash_table(size_t capacity, unsigned shards,
+                                uint64_t (*hash)(const void *),
+                                int (*cmp)(const void *, const void *));
+
+/*
+ * Destroy a chash_table_t structure. The key and value objects
+ * contained in the hash table are left intact. No other thread may
+ * access the hash table any longer.
+ */
+void destroy_chash_table(chash_table_t *table);
+
+/*
+ * Return the number of elements in the hash table. The number is only
+ * approximate if the hash table is being modified concurrently.
+ */
+size_t chash_table_size(chash_table_t *table);
+
+/*
+ * Look up the value associated with a key. Return true and store the
+ * value in *pvalue (if pvalue is not NULL) if a matching element is
+ * found. Otherwise, return false.
+ */
+bool chash_table_get(chash_table_t *table, const void *key,
+                     const void **pvalue);
+
+/*
+ * Associate key with value in the hash table.
+ *
+ * If another element with the same key is already stored in the hash
+ * table, it is replaced, its key and value are stored in *pold_key and
+ * *pold_value (if not NULL) and true is returned. Otherwise, false is
+ * returned.
+ */
+bool chash_table_put(chash_table_t *table, const void *key,
+                     const void *value, const void **pold_key,
+                     const void **pold_value);
+
+/*
+ * Look for an element with a key and remove it from the hash table.
+ * Return true and store the key and value of the element in *pkey and
+ * *pvalue (if not NULL) if a matching element is found. Otherwise,
+ * return false.
+ */
+bool chash_table_pop(chash_table_t *table, const void *key,
+                     const void **pkey, const void **pvalue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __FSDYN_HASHTABLE__
 #define __FSDYN_HASHTABLE__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -12,6 +13,10 @@ extern "C" {
 
 /*
  * Hash tables for C.
+ *
+ * The hash table uses open addressing. Lookups probe a group of
+ * one-byte slot tags at a time (with SIMD instructions where
+ * available) and only dereference elements whose tag matches the key.
  */
 
 /*
@@ -29,10 +34,18 @@ typedef struct hash_elem hash_elem_t;
  * Create a hash_table_t object.
  *
  * The maximum number of elements the hash table is expected to hold is
- * specified with capacity. The hash table can hold more elements but at
- * the expense of performance.
+ * specified with capacity. The hash table can hold more elements; it
+ * grows automatically when its load factor exceeds the maximum (see
+ * hash_table_set_max_load_factor()). The elements are moved over to
+ * the grown table a few at a time by subsequent hash_table_put() calls
+ * so no single call pays for the whole resize. Lookups do not modify
+ * the table, so a table that is not being modified can be read from
+ * several threads at once.
  *
- * A key hash function hash() should scramble keys effectively.
+ * A key hash function hash() should scramble keys effectively. The
+ * hash value of every element is stored in the table and compared
+ * before cmp() is called. The hash function is not called again when
+ * the table is resized.
  *
  * The key comparator cmp() must return 0 for equal keys and a nonzero
  * value for unequal keys.
@@ -40,12 +53,39 @@ typedef struct hash_elem hash_elem_t;
 hash_table_t *make_hash_table(size_t capacity, uint64_t (*hash)(const void *),
                               int (*cmp)(const void *, const void *));
 
+/*
+ * Set the maximum load factor of the hash table, i.e., the ratio of
+ * occupied slots to all slots that triggers growth. The default value
+ * is 0.875. The value is clamped to the range [0.0625, 0.9375]. A
+ * smaller maximum load factor speeds up lookups at the expense of
+ * memory.
+ */
+void hash_table_set_max_load_factor(hash_table_t *table,
+                                    double max_load_factor);
+
 /*
  * Destroy an hash_table_t structure. The key and value objects
  * contained in the hash table are left intact.
  */
 void destroy_hash_table(hash_table_t *table);
 
+/*
+ * Destroy a hash_table_t structure a bit at a time. Every call
+ * destroys at most max_elements (which must be positive) elements and
+ * takes O(max_elements) time. cb() (if not NULL) is called for every
+ * element before it is destroyed. Return true once the whole hash
+ * table has been destroyed and false if more calls are needed.
+ *
+ * After the first call, the hash table may only be passed to
+ * destroy_hash_table_incrementally().
+ */
+bool destroy_hash_table_incrementally(hash_table_t *table,
+                                      size_t max_elements,
+                                      void (*cb)(const void *key,
+                                                 const void *value,
+                                                 void *arg),
+                                      void *arg);
+
 /*
  * Destroy an orphaned key-value association.
  *
@@ -77,6 +117,14 @@ const void *hash_elem_get_value(hash_elem_t *element);
  */
 hash_elem_t *hash_table_get(hash_table_t *table, const void *key);
 
+/*
+ * Like hash_table_get() but with a precomputed key hash, which must be
+ * equal to what the hash function of the table returns for key. A
+ * caller can thus hash a key once and look it up in several tables.
+ */
+hash_elem_t *hash_table_get_hashed(hash_table_t *table, const void *key,
+                                   uint64_t hash);
+
 /*
  * Insert an element into the hash table. The key field of the element
  * must be set before calling hash_table_put() and must not be altered
@@ -93,6 +141,13 @@ hash_elem_t *hash_table_get(hash_table_t *table, const void *key);
 hash_elem_t *hash_table_put(hash_table_t *table, const void *key,
                             const void *value);
 
+/*
+ * Like hash_table_put() but with a precomputed key hash, which must be
+ * equal to what the hash function of the table returns for key.
+ */
+hash_elem_t *hash_table_put_hashed(hash_table_t *table, const void *key,
+                                   const void *value, uint64_t hash);
+
 /*
  * Detach an element from the hash table.
  *
@@ -120,8 +175,8 @@ void hash_table_remove(hash_table_t *table, hash_elem_t *element);
 hash_elem_t *hash_table_pop(hash_table_t *table, const void *key);
 
 /*
- * Detach a random element and return it. Return NULL if the hash table
- * is empty. */
+ * Detach a random element and return it in O(1). Return NULL if the
+ * hash table is empty. */
 hash_elem_t *hash_table_pop_any(hash_table_t *table);
 
 /*
@@ -134,7 +189,11 @@ hash_elem_t *hash_table_get_any(hash_table_t *table);
  * Return some other random element. Return NULL if there is no other
  * element left. You can traverse the whole hash table (in random order)
  * by calling hash_table_get_any() and then repeatedly calling
- * hash_table_get_other().
+ * hash_table_get_other(). The traversal takes time proportional to the
+ * number of elements regardless of the capacity of the hash table.
+ *
+ * The element last returned may be detached during the traversal as
+ * long as hash_table_get_other() has been called on it first.
  */
 hash_elem_t *hash_table_get_other(hash_elem_t *element);
 
@@ -163,6 +222,53 @@ uint64_t hash_unsigned(unsigned_t *value);
  */
 uint64_t hash_blob(const void *blob, size_t size);
 
+/*
+ * The functions above process a byte at a time and are easy to flood
+ * with colliding keys. The functions below process a word at a time
+ * and are seeded.
+ */
+
+/*
+ * Return a random seed that stays the same for the lifetime of the
+ * process.
+ */
+uint64_t hash_seed(void);
+
+/*
+ * A fast function (in the wyhash family) to hash a binary blob with the
+ * given seed. The hash value is the same on every platform.
+ */
+uint64_t hash_blob_seeded(const void *blob, size_t size, uint64_t seed);
+
+/*
+ * Like hash_blob_seeded() but for a NUL-terminated string.
+ */
+uint64_t hash_string_seeded(const char *s, uint64_t seed);
+
+/*
+ * Like hash_blob_seeded() with hash_seed() as the seed.
+ */
+uint64_t hash_blob_fast(const void *blob, size_t size);
+
+/*
+ * Like hash_string_seeded() with hash_seed() as the seed.
+ */
+uint64_t hash_string_fast(const char *s);
+
+/*
+ * Hash a binary blob with SipHash-2-4 using a secret 128-bit key. The
+ * function is slower than hash_blob_fast() but an attacker that does
+ * not know the key cannot produce colliding keys even if they can
+ * observe the iteration order of the hash table. Use it for tables
+ * whose keys come from untrusted sources.
+ */
+uint64_t hash_blob_keyed(const void *blob, size_t size, const uint8_t key[16]);
+
+/*
+ * Like hash_blob_keyed() but for a NUL-terminated string.
+ */
+uint64_t hash_string_keyed(const char *s, const uint8_t key[16]);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,15 +1,37 @@
-#include "list.h"
+#include <stdint.h>
 
+/*
+ * The hash table uses open addressing. Every slot has a control byte
+ * that is either EMPTY, DELETED or holds seven bits of the hash value
+ * of the element in the slot. The control bytes are probed a group at
+ * a time.
+ */
+typedef struct {
+    size_t capacity, size, tombstones;
+    uint8_t *control;
+    hash_elem_t **slots;
+} hash_array_t;
+
+/*
+ * While the hash table is being resized, the elements are gradually
+ * moved from the previous slot array to the current one. The slots of
+ * the previous array below rehash_index have been moved already. Each
+ * insertion moves rehash_step slots.
+ */
 struct hash_table {
-    size_t capacity, size;
+    size_t size;
     uint64_t (*hash)(const void *);
     int (*cmp)(const void *, const void *);
-    list_t **table; /* of hash_elem_t */
+    double max_load_factor;
+    hash_array_t current, previous;
+    size_t rehash_index, rehash_step;
+    hash_elem_t **elements; /* all elements densely, size of them */
+    size_t elements_capacity;
 };
 
 struct hash_elem {
     hash_table_t *hash_table;
-    size_t list_index;
-    list_elem_t *loc;
+    size_t slot, index;
+    uint64_t hash; /* as returned by the hash function */
     const void *key, *value;
 };
@@ -0,0 +1,147 @@
+#ifndef __FSDYN_INTERVALTREE__
+#define __FSDYN_INTERVALTREE__
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interval trees for C.
+ *
+ * An interval_tree_t stores closed intervals [low, high] of points
+ * ordered by a comparator and finds the intervals that overlap a point
+ * or another interval. The intervals are kept in an AVL tree ordered by
+ * their low endpoints, and every subtree remembers its greatest high
+ * endpoint.
+ */
+
+/*
+ * This opaque datatype represents the interval tree.
+ */
+typedef struct interval_tree interval_tree_t;
+
+/*
+ * This opaque datatype represents an interval in the tree.
+ */
+typedef struct interval_elem interval_elem_t;
+
+/*
+ * Create an interval_tree_t object.
+ *
+ * The point comparator cmp() return value is as with memcmp().
+ */
+interval_tree_t *make_interval_tree(int (*cmp)(const void *point1,
+                                               const void *point2));
+
+/*
+ * Create an interval_tree_t object.
+ *
+ * The point comparator cmp() return value is as with memcmp(). The
+ * comparator is given a context argument.
+ */
+interval_tree_t *make_interval_tree_2(int (*cmp)(const void *point1,
+                                                 const void *point2,
+                                                 void *obj),
+                                      void *obj);
+
+/*
+ * Destroy an interval_tree_t structure. The endpoint and value objects
+ * contained in the tree are left intact.
+ */
+void destroy_interval_tree(interval_tree_t *tree);
+
+/*
+ * Return the number of intervals in the tree.
+ */
+size_t interval_tree_size(interval_tree_t *tree);
+
+/*
+ * Return a nonzero value if and only if the tree is empty.
+ */
+int interval_tree_empty(interval_tree_t *tree);
+
+/*
+ * Return the low endpoint of the interval.
+ */
+const void *interval_elem_get_low(interval_elem_t *element);
+
+/*
+ * Return the high endpoint of the interval.
+ */
+const void *interval_elem_get_high(interval_elem_t *element);
+
+/*
+ * Return the value of the interval.
+ */
+const void *interval_elem_get_value(interval_elem_t *element);
+
+/*
+ * Add the interval [low, high] with a value to the tree and return it.
+ * The low endpoint must not be greater than the high endpoint. The tree
+ * may contain equal intervals. The operation takes O(log n) time.
+ */
+interval_elem_t *interval_tree_add(interval_tree_t *tree, const void *low,
+                                   const void *high, const void *value);
+
+/*
+ * Remove an interval from the tree and destroy it. The operation takes
+ * O(log n) time.
+ */
+void interval_tree_remove(interval_tree_t *tree, interval_elem_t *element);
+
+/*
+ * Return the interval with the smallest low endpoint, or NULL if the
+ * tree is empty.
+ */
+interval_elem_t *interval_tree_get_first(interval_tree_t *tree);
+
+/*
+ * Return the successor of the interval in the order of the low
+ * endpoints, or NULL if element is the last interval.
+ */
+interval_elem_t *interval_tree_next(interval_elem_t *element);
+
+/*
+ * Call cb() for every interval that overlaps [low, high] in the order
+ * of the low endpoints and return the number of those intervals. cb()
+ * must not modify the tree. Subtrees without overlapping intervals are
+ * skipped, so reporting k intervals takes O((k + 1) log n) time at most
+ * and less when the reported intervals are adjacent in the tree.
+ */
+size_t interval_tree_overlap(interval_tree_t *tree, const void *low,
+                             const void *high,
+                             void (*cb)(interval_elem_t *element, void *arg),
+                             void *arg);
+
+/*
+ * Call cb() for every interval that contains point and return the number
+ * of those intervals. This is the same as
+ * interval_tree_overlap(tree, point, point, cb, arg).
+ */
+size_t interval_tree_stab(interval_tree_t *tree, const void *point,
+                          void (*cb)(interval_elem_t *element, void *arg),
+                          void *arg);
+
+/*
+ * Call cb() for every pair of points[i] and an interval containing it,
+ * passing i as index, and return the number of such pairs. The n points
+ * must be in ascending order. cb() must not modify the tree. The
+ * intervals are swept in a single pass, so the query takes
+ * O(log n + m log m) time plus O(1) time per reported pair, where m is
+ * the number of intervals whose low endpoints lie between the first and
+ * the last point.
+ */
+size_t interval_tree_stab_sorted(interval_tree_t *tree,
+                                 const void *const points[], size_t n,
+                                 void (*cb)(size_t index,
+                                            interval_elem_t *element,
+                                            void *arg),
+                                 void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __FSDYN_INTMAP__
+#define __FSDYN_INTMAP__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hash maps with 64-bit integer keys.
+ *
+ * Unlike hash_table_t, an intmap_t stores the keys and values in flat
+ * arrays and hashes and compares the keys without callbacks. There are
+ * no element objects.
+ */
+
+typedef struct intmap intmap_t;
+
+/*
+ * Create an intmap_t object. The maximum number of elements the map is
+ * expected to hold is specified with capacity. The map grows as needed.
+ */
+intmap_t *make_intmap(size_t capacity);
+
+/*
+ * Destroy an intmap_t structure. The values contained in the map are
+ * left intact.
+ */
+void destroy_intmap(intmap_t *map);
+
+/*
+ * Return the number of elements in the map.
+ */
+size_t intmap_size(intmap_t *map);
+
+/*
+ * Return a nonzero value if and only if the map is empty.
+ */
+int intmap_empty(intmap_t *map);
+
+/*
+ * Look up the value associated with a key. Return true and store the
+ * value in *pvalue (if pvalue is not NULL) if the key is found.
+ * Otherwise, return false.
+ */
+bool intmap_get(intmap_t *map, uint64_t key, const void **pvalue);
+
+/*
+ * Associate key with value in the map. If the key is already in the
+ * map, store its previous value in *pold_value (if pold_value is not
+ * NULL) and return true. Otherwise, return false.
+ */
+bool intmap_put(intmap_t *map, uint64_t key, const void *value,
+                const void **pold_value);
+
+/*
+ * Remove a key from the map. Return true and store its value in
+ * *pvalue (if pvalue is not NULL) if the key is found. Otherwise,
+ * return false.
+ */
+bool intmap_pop(intmap_t *map, uint64_t key, const void **pvalue);
+
+/*
+ * Traverse the map in an unspecified order. Set *cursor to 0 and call
+ * intmap_next() repeatedly. Each call stores the next key and value in
+ * *pkey and *pvalue (if not NULL) and returns true, or returns false
+ * once all elements have been visited. The map must not be modified
+ * during the traversal.
+ */
+bool intmap_next(intmap_t *map, size_t *cursor, uint64_t *pkey,
+                 const void **pvalue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __FSDYN_KEYED_PRIORITY_QUEUE__
+#define __FSDYN_KEYED_PRIORITY_QUEUE__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Keyed priority queues (heaps) for C.
+ *
+ * A keyed priority queue is like a priority queue (see
+ * priority_queue.h) but every element comes with a uint64_t key that
+ * determines its priority. The key is stored next to the element in
+ * the heap, and the keys are compared without a callback, so the
+ * heap operations do not touch the elements themselves (except
+ * through reloc()). The element with the least key has the highest
+ * priority. */
+
+typedef struct kpriorq kpriorq_t;
+
+/* Create a keyed priority queue.
+ *
+ * The optional reloc() function is called on an element whenever the
+ * element is placed in a new location in the heap structure, which
+ * can happen any time the priority queue is operated on. The function
+ * should store the value of loc so it can be used in a subsequent
+ * kpriorq_remove() or kpriorq_update() call.
+ *
+ * The reloc() function can also be NULL, in which case
+ * kpriorq_remove() and kpriorq_update() cannot be used. */
+kpriorq_t *make_keyed_priority_queue(void (*reloc)(const void *elem,
+                                                   void *loc));
+
+/* Create a keyed priority queue.
+ *
+ * Like make_keyed_priority_queue() but the callback function is given
+ * a context argument. */
+kpriorq_t *make_keyed_priority_queue_2(
+    void (*reloc)(const void *elem, void *loc, void *obj), void *obj);
+
+/* Destroy the priority queue structure. The elements are not affected. */
+void destroy_keyed_priority_queue(kpriorq_t *kprq);
+
+/* Enter an element with key into the priority queue. One element can be
+ * enqueued twice, and two separate elements can have an equal key. */
+void kpriorq_enqueue(kpriorq_t *kprq, uint64_t key, const void *value);
+
+/* Return true if and only if the priority queue has no elements. */
+bool kpriorq_empty(kpriorq_t *kprq);
+
+/* Return the number of elements in the priority queue. */
+size_t kpriorq_size(kpriorq_t *kprq);
+
+/* Remove the element with the least key from the priority queue and
+ * return it. The key is stored in *pkey (if pkey is not NULL).
+ *
+ * If the priority queue is empty, NULL is returned. */
+const void *kpriorq_dequeue(kpriorq_t *kprq, uint64_t *pkey);
+
+/* Return the element with the least key from the priority queue
+ * without removing it. The key is stored in *pkey (if pkey is not
+ * NULL).
+ *
+ * If the priority queue is empty, NULL is returned. */
+const void *kpriorq_peek(kpriorq_t *kprq, uint64_t *pkey);
+
+/* Remove some element from the priority queue and return it. The key
+ * is stored in *pkey (if pkey is not NULL). The function may execute
+ * faster than kpriorq_dequeue().
+ *
+ * If the priority queue is empty, NULL is returned. */
+const void *kpriorq_pop(kpriorq_t *kprq, uint64_t *pkey);
+
+/* Remove the element with the given locator and return it. */
+const void *kpriorq_remove(kpriorq_t *kprq, void *loc);
+
+/* Change the key of the element with the given locator. */
+void kpriorq_update(kpriorq_t *kprq, void *loc, uint64_t key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __FSDYN_LIST__
 #define __FSDYN_LIST__
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -32,6 +33,20 @@ list_t *make_list(void);
  */
 void destroy_list(list_t *list);
 
+/*
+ * Destroy a list_t structure a bit at a time, starting from the
+ * beginning. Every call destroys at most max_elements (which must be
+ * positive) elements. cb() (if not NULL) is called for every element
+ * before it is destroyed. Return true once the whole list has been
+ * destroyed and false if more calls are needed.
+ *
+ * After the first call, the list may only be passed to
+ * destroy_list_incrementally().
+ */
+bool destroy_list_incrementally(list_t *list, size_t max_elements,
+                                void (*cb)(const void *value, void *arg),
+                                void *arg);
+
 /*
  * Return the value of the element (the list member object).
  */
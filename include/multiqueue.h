@@ -0,0 +1,97 @@
+#ifndef __FSDYN_MULTIQUEUE__
+#define __FSDYN_MULTIQUEUE__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Concurrent relaxed priority queues for C.
+ *
+ * A multiqueue consists of a number of priority queues (see
+ * priority_queue.h), each protected by a lock of its own. An element
+ * is enqueued into a randomly chosen queue. A dequeue operation
+ * chooses two queues at random and removes the element with the
+ * higher priority of their two first elements.
+ *
+ * Thus, multiqueue_dequeue() does not necessarily return the element
+ * with the highest priority but one near the front of the queue: with
+ * n queues, the rank of the returned element is O(n) on average. Two
+ * elements enqueued by the same thread are not guaranteed to come out
+ * in priority order. A multiqueue suits the scheduling of work items
+ * where the priority is a hint rather than a strict rule.
+ */
+
+/*
+ * This opaque datatype represents the multiqueue.
+ */
+typedef struct multiqueue multiqueue_t;
+
+/*
+ * Create a multiqueue_t object.
+ *
+ * The cmp() function is as with make_priority_queue(). It is called
+ * concurrently from multiple threads but never on an element that is
+ * not in the multiqueue.
+ *
+ * The number of queues should be a small multiple (two to four) of
+ * the number of threads that access the multiqueue. At least two
+ * queues are created.
+ */
+multiqueue_t *make_multiqueue(unsigned queues,
+                              int (*cmp)(const void *elem1,
+                                         const void *elem2));
+
+/*
+ * Create a multiqueue_t object.
+ *
+ * Like make_multiqueue() but the callback function is given a context
+ * argument.
+ */
+multiqueue_t *make_multiqueue_2(unsigned queues,
+                                int (*cmp)(const void *elem1,
+                                           const void *elem2, void *obj),
+                                void *obj);
+
+/*
+ * Destroy the multiqueue structure. The elements are not affected. No
+ * other thread may access the multiqueue any longer.
+ */
+void destroy_multiqueue(multiqueue_t *mq);
+
+/*
+ * Enter an element into the multiqueue. One element can be enqueued
+ * twice, and two separate elements can be equal in priority.
+ */
+void multiqueue_enqueue(multiqueue_t *mq, const void *value);
+
+/*
+ * Return true if the multiqueue has no elements. The answer is only
+ * approximate if the multiqueue is being modified concurrently.
+ */
+bool multiqueue_empty(multiqueue_t *mq);
+
+/*
+ * Return the number of elements in the multiqueue. The number is only
+ * approximate if the multiqueue is being modified concurrently.
+ */
+size_t multiqueue_size(multiqueue_t *mq);
+
+/*
+ * Remove an element near the front of the multiqueue and return it.
+ *
+ * If the multiqueue is empty, NULL is returned. If other threads are
+ * modifying the multiqueue concurrently, NULL may also be returned
+ * when an element has been enqueued while the queues were being
+ * scanned.
+ */
+const void *multiqueue_dequeue(multiqueue_t *mq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
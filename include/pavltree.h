@@ -0,0 +1,107 @@
+#ifndef __FSDYN_PAVLTREE__
+#define __FSDYN_PAVLTREE__
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Persistent AVL trees for C.
+ *
+ * A pavl_tree_t is a sorted map whose nodes can be shared with other
+ * pavl_tree_t objects. pavl_tree_snapshot() makes a copy of a tree in
+ * O(1) time. After that, modifying either tree copies only the nodes
+ * on the path to the modified key (O(log n) nodes); the other tree is
+ * not affected.
+ *
+ * The nodes are reference-counted atomically, so trees that share nodes
+ * may be used and destroyed in different threads. A single tree object
+ * must not be used by multiple threads at the same time if one of them
+ * modifies it.
+ *
+ * Unlike avl_tree_t, a pavl_tree_t has no element objects; the nodes
+ * have no parent links, which is what lets them be shared.
+ */
+
+typedef struct pavl_tree pavl_tree_t;
+
+/*
+ * Create a pavl_tree_t object.
+ *
+ * The key comparator cmp() return value is as with memcmp().
+ */
+pavl_tree_t *make_pavl_tree(int (*cmp)(const void *key1, const void *key2));
+
+/*
+ * Create a pavl_tree_t object.
+ *
+ * The key comparator cmp() return value is as with memcmp(). The
+ * comparator is given a context argument.
+ */
+pavl_tree_t *make_pavl_tree_2(int (*cmp)(const void *key1, const void *key2,
+                                         void *obj),
+                              void *obj);
+
+/*
+ * Destroy a pavl_tree_t structure. The nodes are freed once no
+ * snapshot refers to them. The key and value objects contained in the
+ * tree are left intact.
+ */
+void destroy_pavl_tree(pavl_tree_t *tree);
+
+/*
+ * Return a new tree with the same contents and comparator as the given
+ * tree. The operation takes O(1) time.
+ */
+pavl_tree_t *pavl_tree_snapshot(pavl_tree_t *tree);
+
+/*
+ * Return the number of elements in the tree.
+ */
+size_t pavl_tree_size(pavl_tree_t *tree);
+
+/*
+ * Return a nonzero value if and only if the tree is empty.
+ */
+int pavl_tree_empty(pavl_tree_t *tree);
+
+/*
+ * Look up the value associated with a key. Return true and store the
+ * value in *pvalue (if pvalue is not NULL) if the key is found.
+ * Otherwise, return false.
+ */
+bool pavl_tree_get(pavl_tree_t *tree, const void *key, const void **pvalue);
+
+/*
+ * Associate key with value in the tree. If the key is already in the
+ * tree, store its previous key and value in *pold_key and *pold_value
+ * (if not NULL) and return true. Otherwise, return false.
+ */
+bool pavl_tree_put(pavl_tree_t *tree, const void *key, const void *value,
+                   const void **pold_key, const void **pold_value);
+
+/*
+ * Remove a key from the tree. Return true and store the key and value
+ * of the removed element in *pkey and *pvalue (if not NULL) if the key
+ * is found. Otherwise, return false.
+ */
+bool pavl_tree_pop(pavl_tree_t *tree, const void *key, const void **pkey,
+                   const void **pvalue);
+
+/*
+ * Call cb() for the elements of the tree in key order until cb()
+ * returns false. Return false if cb() did so, and true otherwise.
+ */
+bool pavl_tree_foreach(pavl_tree_t *tree,
+                       bool (*cb)(const void *key, const void *value,
+                                  void *arg),
+                       void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
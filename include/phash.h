@@ -0,0 +1,101 @@
+#ifndef __FSDYN_PHASH__
+#define __FSDYN_PHASH__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Immutable perfect hash tables stored in image files.
+ *
+ * A phash_builder_t collects key/value blobs and writes them into an
+ * image file together with a minimal perfect hash function of the
+ * keys. A phash_t maps an image file into memory and looks keys up
+ * directly in the mapped pages: opening an image does not depend on
+ * its size, and processes that open the same image share its pages.
+ *
+ * The image uses the byte order of the host that built it.
+ */
+
+typedef struct phash_builder phash_builder_t;
+
+typedef struct phash phash_t;
+
+/*
+ * Create an empty phash_builder_t object.
+ */
+phash_builder_t *make_phash_builder(void);
+
+/*
+ * Destroy a phash_builder_t object.
+ */
+void destroy_phash_builder(phash_builder_t *builder);
+
+/*
+ * Add a key/value pair to the builder. The blobs are copied. Values
+ * are aligned at eight bytes in the image.
+ */
+void phash_builder_add(phash_builder_t *builder, const void *key,
+                       size_t key_size, const void *value, size_t value_size);
+
+/*
+ * Add every element of a hash table to the builder. The encode
+ * callback is called for each key and value of the table and is
+ * expected to call phash_builder_add().
+ */
+void phash_builder_add_hash_table(phash_builder_t *builder,
+                                  hash_table_t *table,
+                                  void (*encode)(void *obj,
+                                                 phash_builder_t *builder,
+                                                 const void *key,
+                                                 const void *value),
+                                  void *obj);
+
+/*
+ * Write an image file of the added pairs. Return true on success. On
+ * failure, return false and set errno. errno is set to EEXIST if the
+ * same key was added twice.
+ *
+ * The image is written into a temporary file next to path, which is
+ * then renamed to path. Thus, an existing image at path is replaced
+ * atomically, and a phash_t that has the old image open keeps working.
+ * A replaced file keeps its permissions; a new file gets 0644.
+ */
+bool phash_builder_write(phash_builder_t *builder, const char *path);
+
+/*
+ * Map an image file into memory. On failure, return NULL and set
+ * errno. errno is set to EINVAL if the file is not a valid image.
+ */
+phash_t *open_phash(const char *path);
+
+/*
+ * Unmap an image file.
+ */
+void close_phash(phash_t *phash);
+
+/*
+ * Return the number of keys in the image.
+ */
+size_t phash_size(phash_t *phash);
+
+/*
+ * Look up a key. If the key is found, return true and store a pointer
+ * to its value and the size of the value in *pvalue and *pvalue_size
+ * (if not NULL). The value stays valid until close_phash() is called.
+ * Otherwise, return false.
+ */
+bool phash_get(phash_t *phash, const void *key, size_t key_size,
+               const void **pvalue, size_t *pvalue_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,6 +39,19 @@ priorq_t *make_priority_queue_2(
     int (*cmp)(const void *elem1, const void *elem2, void *obj),
     void (*reloc)(const void *elem, void *loc, void *obj), void *obj);
 
+/* Create a priority queue.
+ *
+ * Like make_priority_queue_2() but each element of the underlying
+ * heap has arity children instead of two. A greater arity makes the
+ * heap shallower so that enqueuing takes fewer comparisons, while
+ * dequeuing compares more children per level but touches fewer cache
+ * lines. An arity of 4 tends to dequeue the fastest. The arity
+ * is clamped to the range [2, 64]. */
+priorq_t *make_d_ary_priority_queue(
+    int (*cmp)(const void *elem1, const void *elem2, void *obj),
+    void (*reloc)(const void *elem, void *loc, void *obj), void *obj,
+    size_t arity);
+
 /* Destroy the priority queue structure. The elements are not affected. */
 void destroy_priority_queue(priorq_t *prq);
 
@@ -47,6 +60,16 @@ void destroy_priority_queue(priorq_t *prq);
  * priority. */
 void priorq_enqueue(priorq_t *prq, const void *value);
 
+/* Enter n elements into the priority queue at once. If the priority
+ * queue holds at most n elements to begin with, the heap is rebuilt
+ * in O(n) time; otherwise, the elements are enqueued one by one. */
+void priorq_enqueue_array(priorq_t *prq, const void *const values[],
+                          size_t n);
+
+/* Make room for capacity elements in total so that the priority queue
+ * need not grow its storage before it holds more. */
+void priorq_reserve(priorq_t *prq, size_t capacity);
+
 /* Return true if and only if the priority queue has no elements. */
 bool priorq_empty(priorq_t *prq);
 
@@ -76,6 +99,13 @@ const void *priorq_pop(priorq_t *prq);
 /* Remove the element with the given locator and return it. */
 const void *priorq_remove(priorq_t *prq, void *loc);
 
+/* Restore the heap order after the priority of the element with the
+ * given locator has changed. The element is moved toward the head of
+ * the queue if its priority has risen above that of its parent, and
+ * away from the head otherwise. This is cheaper than removing the
+ * element and enqueuing it again. */
+void priorq_update(priorq_t *prq, void *loc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,59 @@
+#ifndef __FSDYN_RADIXHEAP__
+#define __FSDYN_RADIXHEAP__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Monotone radix heaps for C.
+ *
+ * A radix heap is a priority queue of elements with uint64_t keys in
+ * which the least key has the highest priority. It is monotone: no key
+ * may be enqueued that is less than the key dequeued last, which is the
+ * case for deadlines and other clock readings. The keys are compared
+ * without a callback, and enqueuing and dequeuing take amortized
+ * O(log C) time, where C is the greatest difference between a key and
+ * the key dequeued last. */
+
+typedef struct radix_heap radix_heap_t;
+
+/* Create a radix heap. */
+radix_heap_t *make_radix_heap(void);
+
+/* Destroy the radix heap structure. The elements are not affected. */
+void destroy_radix_heap(radix_heap_t *heap);
+
+/* Enter an element with key into the radix heap. One element can be
+ * enqueued twice, and two separate elements can have an equal key.
+ *
+ * If key is less than the key dequeued last, false is returned and
+ * errno is set to EINVAL. */
+bool radix_heap_enqueue(radix_heap_t *heap, uint64_t key, const void *value);
+
+/* Return true if and only if the radix heap has no elements. */
+bool radix_heap_empty(radix_heap_t *heap);
+
+/* Return the number of elements in the radix heap. */
+size_t radix_heap_size(radix_heap_t *heap);
+
+/* Remove the element with the least key from the radix heap and return
+ * it. The key is stored in *pkey (if pkey is not NULL).
+ *
+ * If the radix heap is empty, NULL is returned. */
+const void *radix_heap_dequeue(radix_heap_t *heap, uint64_t *pkey);
+
+/* Return the element with the least key from the radix heap without
+ * removing it. The key is stored in *pkey (if pkey is not NULL).
+ *
+ * If the radix heap is empty, NULL is returned. */
+const void *radix_heap_peek(radix_heap_t *heap, uint64_t *pkey);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
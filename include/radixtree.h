@@ -0,0 +1,109 @@
+#ifndef __FSDYN_RADIXTREE__
+#define __FSDYN_RADIXTREE__
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Adaptive radix trees for C.
+ *
+ * A radix_tree_t maps byte-string keys to values. The keys are ordered
+ * lexicographically by bytes, with a key ordered before the keys it is a
+ * prefix of. A lookup branches on one key byte per level and compares
+ * the whole key only once, at the end, so it takes O(key length) time
+ * regardless of the number of keys. Inner nodes have room for 4, 16, 48
+ * or 256 children depending on how many they need, and chains of single
+ * children are collapsed into prefixes.
+ *
+ * The tree refers to the key bytes given to radix_tree_put(); they must
+ * not be altered or freed while the key is in the tree.
+ */
+
+typedef struct radix_tree radix_tree_t;
+
+/*
+ * Create a radix_tree_t object.
+ */
+radix_tree_t *make_radix_tree(void);
+
+/*
+ * Destroy a radix_tree_t structure. The key and value objects contained
+ * in the tree are left intact.
+ */
+void destroy_radix_tree(radix_tree_t *tree);
+
+/*
+ * Return the number of keys in the tree.
+ */
+size_t radix_tree_size(radix_tree_t *tree);
+
+/*
+ * Return a nonzero value if and only if the tree is empty.
+ */
+int radix_tree_empty(radix_tree_t *tree);
+
+/*
+ * Look up the value associated with a key of size bytes. Return true
+ * and store the value in *pvalue (if pvalue is not NULL) if the key is
+ * found. Otherwise, return false.
+ */
+bool radix_tree_get(radix_tree_t *tree, const void *key, size_t size,
+                    const void **pvalue);
+
+/*
+ * Associate a key of size bytes with value in the tree. If the key is
+ * already in the tree, store its previous key and value in *pold_key
+ * and *pold_value (if not NULL) and return true. Otherwise, return
+ * false.
+ */
+bool radix_tree_put(radix_tree_t *tree, const void *key, size_t size,
+                    const void *value, const void **pold_key,
+                    const void **pold_value);
+
+/*
+ * Remove a key of size bytes from the tree. Return true and store the
+ * key and value of the removed association in *pkey and *pvalue (if not
+ * NULL) if the key is found. Otherwise, return false.
+ */
+bool radix_tree_pop(radix_tree_t *tree, const void *key, size_t size,
+                    const void **pkey, const void **pvalue);
+
+/*
+ * Call cb() for the keys of the tree in order until cb() returns false.
+ * Return false if cb() did so, and true otherwise. cb() must not modify
+ * the tree.
+ */
+bool radix_tree_foreach(radix_tree_t *tree,
+                        bool (*cb)(const void *key, size_t size,
+                                   const void *value, void *arg),
+                        void *arg);
+
+/*
+ * Like radix_tree_foreach() but only for the keys that begin with the
+ * given prefix of size bytes.
+ */
+bool radix_tree_scan_prefix(radix_tree_t *tree, const void *prefix,
+                            size_t size,
+                            bool (*cb)(const void *key, size_t key_size,
+                                       const void *value, void *arg),
+                            void *arg);
+
+/*
+ * Find the longest key in the tree that is a prefix of the given key of
+ * size bytes (or the key itself). Return true and store the key, its
+ * size and its value in *pkey, *pkey_size and *pvalue (if not NULL) if
+ * such a key is found. Otherwise, return false.
+ */
+bool radix_tree_longest_prefix(radix_tree_t *tree, const void *key,
+                               size_t size, const void **pkey,
+                               size_t *pkey_size, const void **pvalue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __FSDYN_TIMERWHEEL__
+#define __FSDYN_TIMERWHEEL__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hierarchical timing wheels for C.
+ *
+ * A timer_wheel_t holds timers that expire at integer ticks. The unit
+ * of a tick is up to the user. Scheduling and canceling a timer take
+ * O(1) time and involve no comparator calls. Advancing the clock
+ * skips empty stretches of time and expires the due timers a tick at a
+ * time. A timer far in the future is kept in a coarse wheel and
+ * moved to finer wheels as its expiry draws near, which happens at
+ * most a few times per timer.
+ */
+
+/*
+ * This opaque datatype represents the timing wheel.
+ */
+typedef struct timer_wheel timer_wheel_t;
+
+/*
+ * This opaque datatype represents a scheduled timer. It serves as the
+ * locator of the timer for timer_wheel_cancel().
+ */
+typedef struct timer_wheel_elem timer_wheel_elem_t;
+
+/*
+ * Create a timer_wheel_t object whose clock is at now.
+ */
+timer_wheel_t *make_timer_wheel(uint64_t now);
+
+/*
+ * Destroy a timer_wheel_t structure. The value objects of the pending
+ * timers are left intact.
+ */
+void destroy_timer_wheel(timer_wheel_t *wheel);
+
+/*
+ * Return the number of pending timers.
+ */
+size_t timer_wheel_size(timer_wheel_t *wheel);
+
+/*
+ * Return true if and only if there are no pending timers.
+ */
+bool timer_wheel_empty(timer_wheel_t *wheel);
+
+/*
+ * Return the current time of the wheel, i.e., the greatest value
+ * given to make_timer_wheel() or timer_wheel_advance().
+ */
+uint64_t timer_wheel_now(timer_wheel_t *wheel);
+
+/*
+ * Return the expiry of a pending timer.
+ */
+uint64_t timer_wheel_elem_get_expiry(timer_wheel_elem_t *element);
+
+/*
+ * Return the value of a pending timer.
+ */
+const void *timer_wheel_elem_get_value(timer_wheel_elem_t *element);
+
+/*
+ * Schedule a timer with value to expire at the given tick and return
+ * its locator. An expiry that is not later than the current time of
+ * the wheel makes the timer expire on the next timer_wheel_advance()
+ * call.
+ *
+ * The locator is valid until the timer expires or is canceled.
+ */
+timer_wheel_elem_t *timer_wheel_schedule(timer_wheel_t *wheel,
+                                         uint64_t expiry, const void *value);
+
+/*
+ * Cancel a pending timer and return its value.
+ */
+const void *timer_wheel_cancel(timer_wheel_t *wheel,
+                               timer_wheel_elem_t *element);
+
+/*
+ * Find the earliest expiry of the pending timers. Return true and store
+ * it in *pexpiry if there are pending timers. Otherwise, return false.
+ */
+bool timer_wheel_next_expiry(timer_wheel_t *wheel, uint64_t *pexpiry);
+
+/*
+ * Move the clock of the wheel forward to now and expire the timers
+ * whose expiry is not later than now. cb() is called for every
+ * expired timer with its value. The timers are expired a tick at a
+ * time in order; the timers of a single tick, which include the timers
+ * scheduled in the past, are expired in no particular order. The
+ * number of expired timers is returned. If now is earlier than the
+ * current time of the wheel, only the timers scheduled in the past are
+ * expired.
+ *
+ * cb() may schedule and cancel timers. The locator of the expired
+ * timer is no longer valid when cb() is called.
+ */
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now,
+                           void (*cb)(const void *value, void *arg),
+                           void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
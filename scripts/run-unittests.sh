@@ -57,8 +57,10 @@ run-test () {
 run-tests () {
     local arch=$1
     run-test $arch stage/$arch/build/test/avltest &&
+    run-test $arch stage/$arch/build/test/btree_test &&
     run-test $arch stage/$arch/build/test/bytearray_test &&
     run-test $arch stage/$arch/build/test/intset_test &&
+    run-test $arch stage/$arch/build/test/chash_test &&
     run-test $arch stage/$arch/build/test/charstr_normalization_test \
          unicode/NormalizationTest.txt &&
     run-test $arch stage/$arch/build/test/charstr_idna_test \
@@ -69,7 +71,17 @@ run-tests () {
     run-test $arch stage/$arch/build/test/base64_test &&
     run-test $arch stage/$arch/build/test/date_test &&
     run-test $arch stage/$arch/build/test/float_test &&
-    run-test $arch stage/$arch/build/test/priorq_test
+    run-test $arch stage/$arch/build/test/hashtable_test &&
+    run-test $arch stage/$arch/build/test/intervaltree_test &&
+    run-test $arch stage/$arch/build/test/intmap_test &&
+    run-test $arch stage/$arch/build/test/kpriorq_test &&
+    run-test $arch stage/$arch/build/test/multiqueue_test &&
+    run-test $arch stage/$arch/build/test/pavltree_test &&
+    run-test $arch stage/$arch/build/test/phash_test &&
+    run-test $arch stage/$arch/build/test/priorq_test &&
+    run-test $arch stage/$arch/build/test/radixheap_test &&
+    run-test $arch stage/$arch/build/test/radixtree_test &&
+    run-test $arch stage/$arch/build/test/timerwheel_test
 }
 
 main "$@"
@@ -1,5 +1,8 @@
 #include "avltree.h"
 
+#include <errno.h>
+#include <stdint.h>
+
 #include "avltree_imp.h"
 #include "fsalloc.h"
 #include "fsdyn_version.h"
@@ -22,6 +25,7 @@ avl_tree_t *make_avl_tree_2(int (*cmp)(const void *, const void *, void *),
     tree->obj = obj;
     tree->root = NULL;
     tree->size = 0;
+    tree->augment = NULL;
     return tree;
 }
 
@@ -30,21 +34,58 @@ avl_tree_t *make_avl_tree(int (*cmp)(const void *, const void *))
     return make_avl_tree_2((void *) cmp, NULL);
 }
 
-static void destroy_subtree(avl_elem_t *element)
+/* Destroy the elements of a subtree in key order without recursion,
+ * rotating the left children up until the leftmost element is at the
+ * top. Every step either rotates or destroys an element, and there are
+ * fewer rotations than elements. Stop after max_steps steps and return
+ * what is left of the subtree. */
+static avl_elem_t *release_some(avl_elem_t *element, size_t max_steps,
+                                void (*cb)(const void *, const void *,
+                                           void *),
+                                void *arg)
 {
-    if (element != NULL) {
-        destroy_subtree(element->left);
-        destroy_subtree(element->right);
+    for (; element && max_steps; max_steps--) {
+        avl_elem_t *left = element->left;
+        if (left) {
+            element->left = left->right;
+            left->right = element;
+            element = left;
+            continue;
+        }
+        avl_elem_t *right = element->right;
+        if (cb)
+            cb(element->key, element->value, arg);
         fsfree(element);
+        element = right;
     }
+    return element;
+}
+
+static void release_subtree(avl_elem_t *element,
+                            void (*cb)(const void *, const void *, void *),
+                            void *arg)
+{
+    release_some(element, SIZE_MAX, cb, arg);
 }
 
 void destroy_avl_tree(avl_tree_t *tree)
 {
-    destroy_subtree(tree->root);
+    release_subtree(tree->root, NULL, NULL);
     fsfree(tree);
 }
 
+bool destroy_avl_tree_incrementally(avl_tree_t *tree, size_t max_elements,
+                                    void (*cb)(const void *key,
+                                               const void *value, void *arg),
+                                    void *arg)
+{
+    tree->root = release_some(tree->root, max_elements, cb, arg);
+    if (tree->root)
+        return false;
+    fsfree(tree);
+    return true;
+}
+
 static avl_elem_t *make_element(const void *key, const void *value)
 {
     avl_elem_t *element = fsalloc(sizeof *element);
@@ -52,6 +93,7 @@ static avl_elem_t *make_element(const void *key, const void *value)
     element->value = value;
     element->parent = element->left = element->right = NULL;
     element->balance = 0;
+    element->count = 1;
     return element;
 }
 
@@ -189,6 +231,42 @@ avl_elem_t *avl_tree_get_on_or_after(avl_tree_t *tree, const void *key)
     return candidate;
 }
 
+static size_t count_of(avl_elem_t *element)
+{
+    return element ? element->count : 0;
+}
+
+static void recount(avl_elem_t *element)
+{
+    element->count = 1 + count_of(element->left) + count_of(element->right);
+}
+
+static void augment(avl_tree_t *tree, avl_elem_t *element)
+{
+    if (tree->augment)
+        tree->augment(element, tree->obj);
+}
+
+/* Update the top of a rotated subtree and the children of the top. */
+static void augment_rotated(avl_tree_t *tree, avl_elem_t *top)
+{
+    if (!tree->augment)
+        return;
+    if (top->left)
+        tree->augment(top->left, tree->obj);
+    if (top->right)
+        tree->augment(top->right, tree->obj);
+    tree->augment(top, tree->obj);
+}
+
+static void augment_path(avl_tree_t *tree, avl_elem_t *element)
+{
+    if (!tree->augment)
+        return;
+    for (; element; element = element->parent)
+        tree->augment(element, tree->obj);
+}
+
 static avl_elem_t *rotate_right(avl_elem_t *element)
 {
     avl_elem_t *new_top;
@@ -197,6 +275,7 @@ static avl_elem_t *rotate_right(avl_elem_t *element)
         element->left = new_top->right;
         new_top->right = element;
         element->balance = -++new_top->balance;
+        recount(element);
     } else {
         new_top = element->left->right;
         element->left->right = new_top->left;
@@ -209,7 +288,10 @@ static avl_elem_t *rotate_right(avl_elem_t *element)
         new_top->left->balance = -((1 + new_top->balance) / 2);
         new_top->right->balance = (1 - new_top->balance) / 2;
         new_top->balance = 0;
+        recount(new_top->left);
+        recount(new_top->right);
     }
+    recount(new_top);
     new_top->parent = element->parent;
     element->parent = new_top;
     if (element->left != NULL)
@@ -227,15 +309,22 @@ static int put_left(avl_tree_t *tree, avl_elem_t **ploc, avl_elem_t *element,
     if (loc->left == NULL) {
         element->parent = loc;
         loc->left = element;
+        loc->count++;
         tree->size++;
         loc->balance--;
+        augment(tree, element);
+        augment(tree, loc);
         return loc->right == NULL;
     }
-    if (!put(tree, &loc->left, element, premoved_element))
+    int grown = put(tree, &loc->left, element, premoved_element);
+    recount(loc);
+    augment(tree, loc);
+    if (!grown)
         return 0;
     switch (--loc->balance) {
         case -2:
             *ploc = rotate_right(loc);
+            augment_rotated(tree, *ploc);
             return 0;
         case -1:
             return 1;
@@ -252,6 +341,7 @@ static avl_elem_t *rotate_left(avl_elem_t *element)
         element->right = new_top->left;
         new_top->left = element;
         element->balance = -(--new_top->balance);
+        recount(element);
     } else {
         new_top = element->right->left;
         element->right->left = new_top->right;
@@ -264,7 +354,10 @@ static avl_elem_t *rotate_left(avl_elem_t *element)
         new_top->right->balance = (1 - new_top->balance) / 2;
         new_top->left->balance = -((1 + new_top->balance) / 2);
         new_top->balance = 0;
+        recount(new_top->left);
+        recount(new_top->right);
     }
+    recount(new_top);
     new_top->parent = element->parent;
     element->parent = new_top;
     if (element->right != NULL)
@@ -279,15 +372,22 @@ static int put_right(avl_tree_t *tree, avl_elem_t **ploc, avl_elem_t *element,
     if (loc->right == NULL) {
         element->parent = loc;
         loc->right = element;
+        loc->count++;
         tree->size++;
         loc->balance++;
+        augment(tree, element);
+        augment(tree, loc);
         return loc->left == NULL;
     }
-    if (!put(tree, &loc->right, element, premoved_element))
+    int grown = put(tree, &loc->right, element, premoved_element);
+    recount(loc);
+    augment(tree, loc);
+    if (!grown)
         return 0;
     switch (++loc->balance) {
         case 2:
             *ploc = rotate_left(loc);
+            augment_rotated(tree, *ploc);
             return 0;
         case 1:
             return 1;
@@ -310,6 +410,22 @@ static void substitute(avl_tree_t *tree, avl_elem_t *new_child,
     }
 }
 
+static void replace(avl_tree_t *tree, avl_elem_t *old_element,
+                    avl_elem_t *element)
+{
+    element->parent = old_element->parent;
+    element->left = old_element->left;
+    element->right = old_element->right;
+    element->balance = old_element->balance;
+    element->count = old_element->count;
+    substitute(tree, element, old_element);
+    if (element->left)
+        element->left->parent = element;
+    if (element->right)
+        element->right->parent = element;
+    augment_path(tree, element);
+}
+
 static int put(avl_tree_t *tree, avl_elem_t **ploc, avl_elem_t *element,
                avl_elem_t **premoved_element)
 {
@@ -321,15 +437,7 @@ static int put(avl_tree_t *tree, avl_elem_t **ploc, avl_elem_t *element,
         return put_right(tree, ploc, element, premoved_element);
     if (loc == element)
         return 0;
-    element->parent = loc->parent;
-    element->left = loc->left;
-    element->right = loc->right;
-    element->balance = loc->balance;
-    substitute(tree, element, loc);
-    if (element->left)
-        element->left->parent = element;
-    if (element->right)
-        element->right->parent = element;
+    replace(tree, loc, element);
     *premoved_element = loc;
     return 0;
 }
@@ -340,6 +448,7 @@ avl_elem_t *avl_tree_put(avl_tree_t *tree, const void *key, const void *value)
     if (tree->root == NULL) {
         tree->root = element;
         tree->size = 1;
+        augment(tree, element);
         return NULL;
     }
     avl_elem_t *removed_element = NULL;
@@ -347,6 +456,157 @@ avl_elem_t *avl_tree_put(avl_tree_t *tree, const void *key, const void *value)
     return removed_element;
 }
 
+/* Hang a new leaf under parent and rebalance the tree bottom-up. */
+static void attach(avl_tree_t *tree, avl_elem_t *parent, avl_elem_t *element,
+                   int cmp)
+{
+    element->parent = parent;
+    if (cmp < 0)
+        parent->left = element;
+    else
+        parent->right = element;
+    tree->size++;
+    augment(tree, element);
+    int grown = 1;
+    avl_elem_t *child = element, *loc = parent;
+    while (loc != NULL) {
+        avl_elem_t *above = loc->parent;
+        loc->count++;
+        augment(tree, loc);
+        if (grown) {
+            loc->balance += loc->left == child ? -1 : 1;
+            if (loc->balance == 0)
+                grown = 0;
+            else if (loc->balance == -2 || loc->balance == 2) {
+                avl_elem_t *top =
+                    loc->balance < 0 ? rotate_right(loc) : rotate_left(loc);
+                augment_rotated(tree, top);
+                if (above == NULL)
+                    tree->root = top;
+                else if (above->left == loc)
+                    above->left = top;
+                else
+                    above->right = top;
+                loc = top;
+                grown = 0;
+            }
+        }
+        child = loc;
+        loc = above;
+    }
+}
+
+/* Insert element in the subtree under loc, whose keys are all on the
+ * same side of element->key as loc->key is. */
+static avl_elem_t *put_below(avl_tree_t *tree, avl_elem_t *loc,
+                             avl_elem_t *element)
+{
+    for (;;) {
+        int cmp = tree->cmp(element->key, loc->key, tree->obj);
+        if (cmp == 0) {
+            replace(tree, loc, element);
+            return loc;
+        }
+        avl_elem_t *child = cmp < 0 ? loc->left : loc->right;
+        if (child == NULL) {
+            attach(tree, loc, element, cmp);
+            return NULL;
+        }
+        loc = child;
+    }
+}
+
+/* Climb from hint only as far as needed to find the subtree in which
+ * element belongs, and descend from there. Only the ancestors on the
+ * element's side of the path are compared, so a sequential insertion
+ * costs O(1) comparisons, but the descent may cover a whole subtree,
+ * so the worst case is O(log n). */
+static avl_elem_t *put_near(avl_tree_t *tree, avl_elem_t *hint,
+                            avl_elem_t *element)
+{
+    if (tree->root == NULL) {
+        tree->root = element;
+        tree->size = 1;
+        augment(tree, element);
+        return NULL;
+    }
+    if (hint == NULL)
+        return put_below(tree, tree->root, element);
+    int cmp = tree->cmp(element->key, hint->key, tree->obj);
+    if (cmp == 0) {
+        replace(tree, hint, element);
+        return hint;
+    }
+    /* The keys between hint and element are in the subtree on the
+     * element's side of start. */
+    avl_elem_t *start = hint, *loc = hint;
+    avl_elem_t *parent;
+    while ((parent = loc->parent) != NULL) {
+        if ((cmp > 0) == (parent->left == loc)) {
+            int c = tree->cmp(element->key, parent->key, tree->obj);
+            if (c == 0) {
+                replace(tree, parent, element);
+                return parent;
+            }
+            if ((c > 0) != (cmp > 0))
+                break;
+            start = parent;
+        }
+        loc = parent;
+    }
+    avl_elem_t *child = cmp < 0 ? start->left : start->right;
+    if (child == NULL) {
+        attach(tree, start, element, cmp);
+        return NULL;
+    }
+    return put_below(tree, child, element);
+}
+
+avl_elem_t *avl_tree_put_hint(avl_tree_t *tree, avl_elem_t *hint,
+                              const void *key, const void *value)
+{
+    return put_near(tree, hint, make_element(key, value));
+}
+
+avl_elem_t *avl_tree_put_element(avl_tree_t *tree, const void *key,
+                                 const void *value,
+                                 avl_elem_t **premoved_element)
+{
+    avl_elem_t *element = make_element(key, value);
+    avl_elem_t *removed_element = put_near(tree, NULL, element);
+    if (premoved_element)
+        *premoved_element = removed_element;
+    return element;
+}
+
+avl_cursor_t *make_avl_cursor(avl_tree_t *tree)
+{
+    avl_cursor_t *cursor = fsalloc(sizeof *cursor);
+    cursor->tree = tree;
+    cursor->position = NULL;
+    return cursor;
+}
+
+void destroy_avl_cursor(avl_cursor_t *cursor)
+{
+    fsfree(cursor);
+}
+
+void avl_cursor_reset(avl_cursor_t *cursor)
+{
+    cursor->position = NULL;
+}
+
+avl_elem_t *avl_cursor_put(avl_cursor_t *cursor, const void *key,
+                           const void *value)
+{
+    avl_elem_t *element = make_element(key, value);
+    avl_elem_t *removed_element =
+        put_near(cursor->tree, cursor->position, element);
+    cursor->position = element;
+    return removed_element;
+}
+
 static int leaf_element(avl_elem_t *element)
 {
     return element->right == NULL && element->left == NULL;
@@ -382,6 +642,7 @@ static void lighten_right(avl_tree_t *tree, avl_elem_t *element)
             break;
         case -2:
             new_top = rotate_right(element);
+            augment_rotated(tree, new_top);
             if (element == tree->root) {
                 tree->root = new_top;
                 break;
@@ -407,6 +668,7 @@ static void lighten_left(avl_tree_t *tree, avl_elem_t *element)
             break;
         case 2:
             new_top = rotate_left(element);
+            augment_rotated(tree, new_top);
             if (element == tree->root) {
                 tree->root = new_top;
                 break;
@@ -438,6 +700,9 @@ static void exchange(avl_tree_t *tree, avl_elem_t *e1, avl_elem_t *e2)
     int b = e1->balance;
     e1->balance = e2->balance;
     e2->balance = b;
+    size_t c = e1->count;
+    e1->count = e2->count;
+    e2->count = c;
     if (e1->left != NULL)
         e1->left->parent = e1;
     if (e1->right != NULL)
@@ -452,13 +717,18 @@ void avl_tree_detach(avl_tree_t *tree, avl_elem_t *element)
 {
     while (!leaf_element(element))
         exchange(tree, element, adjacent_descendant(element));
+    avl_elem_t *ancestor;
+    for (ancestor = element->parent; ancestor; ancestor = ancestor->parent)
+        ancestor->count--;
     if (element == tree->root)
         tree->root = NULL;
     else if (element->parent->left == element) {
         element->parent->left = NULL;
+        augment_path(tree, element->parent);
         lighten_left(tree, element->parent);
     } else {
         element->parent->right = NULL;
+        augment_path(tree, element->parent);
         lighten_right(tree, element->parent);
     }
     tree->size--;
@@ -523,6 +793,7 @@ static avl_elem_t *copy_tree(avl_elem_t *element)
 {
     avl_elem_t *copy = make_element(element->key, element->value);
     copy->balance = element->balance;
+    copy->count = element->count;
     if (element->left) {
         copy->left = copy_tree(element->left);
         copy->left->parent = copy;
@@ -543,3 +814,519 @@ avl_tree_t *avl_tree_copy(avl_tree_t *tree)
     }
     return copy;
 }
+
+avl_elem_t *avl_tree_get_by_rank(avl_tree_t *tree, size_t rank)
+{
+    avl_elem_t *element = tree->root;
+    while (element) {
+        size_t left_count = count_of(element->left);
+        if (rank == left_count)
+            return element;
+        if (rank < left_count)
+            element = element->left;
+        else {
+            rank -= left_count + 1;
+            element = element->right;
+        }
+    }
+    return NULL;
+}
+
+size_t avl_tree_rank(avl_tree_t *tree, const void *key)
+{
+    avl_elem_t *element = tree->root;
+    void *obj = tree->obj;
+    size_t rank = 0;
+    while (element) {
+        int cmp = tree->cmp(key, element->key, obj);
+        if (cmp <= 0)
+            element = element->left;
+        else {
+            rank += count_of(element->left) + 1;
+            element = element->right;
+        }
+    }
+    return rank;
+}
+
+size_t avl_elem_get_rank(avl_elem_t *element)
+{
+    size_t rank = count_of(element->left);
+    for (; element->parent; element = element->parent)
+        if (element->parent->right == element)
+            rank += count_of(element->parent->left) + 1;
+    return rank;
+}
+
+static int height_of_size(size_t n)
+{
+    int height = 0;
+    for (; n; n >>= 1)
+        height++;
+    return height;
+}
+
+/* Build a subtree of the n elements starting at index first. The left
+ * subtree gets the smaller half, so it is at most one level lower. */
+static avl_elem_t *build_subtree(const void *const keys[],
+                                 const void *const values[], size_t first,
+                                 size_t n, avl_elem_t *parent)
+{
+    if (n == 0)
+        return NULL;
+    size_t middle = first + (n - 1) / 2;
+    avl_elem_t *element =
+        make_element(keys[middle], values ? values[middle] : keys[middle]);
+    element->parent = parent;
+    element->count = n;
+    size_t left_count = middle - first, right_count = n - 1 - left_count;
+    element->balance =
+        height_of_size(right_count) - height_of_size(left_count);
+    element->left = build_subtree(keys, values, first, left_count, element);
+    element->right =
+        build_subtree(keys, values, middle + 1, right_count, element);
+    return element;
+}
+
+void avl_tree_build_sorted(avl_tree_t *tree, const void *const keys[],
+                           const void *const values[], size_t n)
+{
+    tree->root = build_subtree(keys, values, 0, n, NULL);
+    tree->size = n;
+}
+
+bool avl_tree_build_sorted_checked(avl_tree_t *tree, const void *const keys[],
+                                   const void *const values[], size_t n)
+{
+    if (!avl_tree_empty(tree)) {
+        errno = EEXIST;
+        return false;
+    }
+    size_t i;
+    for (i = 1; i < n; i++)
+        if (tree->cmp(keys[i - 1], keys[i], tree->obj) >= 0) {
+            errno = EINVAL;
+            return false;
+        }
+    avl_tree_build_sorted(tree, keys, values, n);
+    return true;
+}
+
+/*
+ * The join-based operations below work on subtrees whose roots have no
+ * parent and whose heights are passed along with them. A height can be
+ * derived from that of the parent and the balance of the parent.
+ */
+
+static avl_elem_t *orphan(avl_elem_t *element)
+{
+    if (element)
+        element->parent = NULL;
+    return element;
+}
+
+static int height_of_left(avl_elem_t *element, int height)
+{
+    return element->balance > 0 ? height - 2 : height - 1;
+}
+
+static int height_of_right(avl_elem_t *element, int height)
+{
+    return element->balance < 0 ? height - 2 : height - 1;
+}
+
+static int subtree_height(avl_elem_t *element)
+{
+    int height = 0;
+    for (; element; height++)
+        element = element->balance < 0 ? element->left : element->right;
+    return height;
+}
+
+static void link_children(avl_elem_t *element)
+{
+    if (element->left)
+        element->left->parent = element;
+    if (element->right)
+        element->right->parent = element;
+    recount(element);
+}
+
+/* Join when the left subtree is more than one level higher: hang
+ * middle from the right spine of left where the heights match and
+ * rebalance upwards as after an insertion. The subtree that grew only
+ * stops growing if a rotation leaves a balanced top. */
+static avl_elem_t *join_right(avl_elem_t *left, int left_height,
+                              avl_elem_t *middle, avl_elem_t *right,
+                              int right_height, int *pheight)
+{
+    size_t added = 1 + count_of(right);
+    avl_elem_t *root = left, *parent = NULL, *child = left;
+    int height = left_height;
+    while (height > right_height + 1) {
+        child->count += added;
+        height = height_of_right(child, height);
+        parent = child;
+        child = child->right;
+    }
+    middle->left = child;
+    middle->right = right;
+    middle->parent = parent;
+    middle->balance = right_height - height;
+    link_children(middle);
+    parent->right = middle;
+    *pheight = left_height;
+    while (parent) {
+        if (++parent->balance == 0)
+            return root;
+        if (parent->balance == 1) {
+            parent = parent->parent;
+            continue;
+        }
+        avl_elem_t *grandparent = parent->parent;
+        avl_elem_t *top = rotate_left(parent);
+        if (grandparent)
+            grandparent->right = top;
+        else
+            root = top;
+        if (top->balance == 0)
+            return root;
+        parent = grandparent;
+    }
+    *pheight = left_height + 1;
+    return root;
+}
+
+static avl_elem_t *join_left(avl_elem_t *left, int left_height,
+                             avl_elem_t *middle, avl_elem_t *right,
+                             int right_height, int *pheight)
+{
+    size_t added = 1 + count_of(left);
+    avl_elem_t *root = right, *parent = NULL, *child = right;
+    int height = right_height;
+    while (height > left_height + 1) {
+        child->count += added;
+        height = height_of_left(child, height);
+        parent = child;
+        child = child->left;
+    }
+    middle->left = left;
+    middle->right = child;
+    middle->parent = parent;
+    middle->balance = height - left_height;
+    link_children(middle);
+    parent->left = middle;
+    *pheight = right_height;
+    while (parent) {
+        if (--parent->balance == 0)
+            return root;
+        if (parent->balance == -1) {
+            parent = parent->parent;
+            continue;
+        }
+        avl_elem_t *grandparent = parent->parent;
+        avl_elem_t *top = rotate_right(parent);
+        if (grandparent)
+            grandparent->left = top;
+        else
+            root = top;
+        if (top->balance == 0)
+            return root;
+        parent = grandparent;
+    }
+    *pheight = right_height + 1;
+    return root;
+}
+
+/* Join two subtrees and an element whose key lies between them. */
+static avl_elem_t *join(avl_elem_t *left, int left_height, avl_elem_t *middle,
+                        avl_elem_t *right, int right_height, int *pheight)
+{
+    if (left_height > right_height + 1)
+        return join_right(left, left_height, middle, right, right_height,
+                          pheight);
+    if (right_height > left_height + 1)
+        return join_left(left, left_height, middle, right, right_height,
+                         pheight);
+    middle->left = left;
+    middle->right = right;
+    middle->parent = NULL;
+    middle->balance = right_height - left_height;
+    link_children(middle);
+    *pheight = (left_height > right_height ? left_height : right_height) + 1;
+    return middle;
+}
+
+/* Split a subtree into the elements whose keys are less than key and
+ * those whose keys are greater than key. Return the detached element
+ * whose key equals key or NULL. */
+static avl_elem_t *split(avl_tree_t *tree, avl_elem_t *root, int height,
+                         const void *key, avl_elem_t **pleft,
+                         int *pleft_height, avl_elem_t **pright,
+                         int *pright_height)
+{
+    if (!root) {
+        *pleft = *pright = NULL;
+        *pleft_height = *pright_height = 0;
+        return NULL;
+    }
+    avl_elem_t *left = orphan(root->left), *right = orphan(root->right);
+    int lh = height_of_left(root, height), rh = height_of_right(root, height);
+    int cmp = tree->cmp(key, root->key, tree->obj);
+    if (cmp == 0) {
+        *pleft = left;
+        *pleft_height = lh;
+        *pright = right;
+        *pright_height = rh;
+        root->left = root->right = NULL;
+        root->balance = 0;
+        root->count = 1;
+        return root;
+    }
+    avl_elem_t *found;
+    if (cmp < 0) {
+        found = split(tree, left, lh, key, pleft, pleft_height, pright,
+                      pright_height);
+        *pright = join(*pright, *pright_height, root, right, rh,
+                       pright_height);
+    } else {
+        found = split(tree, right, rh, key, pleft, pleft_height, pright,
+                      pright_height);
+        *pleft = join(left, lh, root, *pleft, *pleft_height, pleft_height);
+    }
+    return found;
+}
+
+/* Detach the last element of a nonempty subtree. */
+static avl_elem_t *split_last(avl_elem_t *root, int height, avl_elem_t **prest,
+                              int *prest_height)
+{
+    avl_elem_t *left = orphan(root->left), *right = orphan(root->right);
+    int lh = height_of_left(root, height), rh = height_of_right(root, height);
+    if (!right) {
+        *prest = left;
+        *prest_height = lh;
+        return root;
+    }
+    avl_elem_t *last = split_last(right, rh, prest, prest_height);
+    *prest = join(left, lh, root, *prest, *prest_height, prest_height);
+    return last;
+}
+
+/* Join two subtrees whose keys are in order. */
+static avl_elem_t *join2(avl_elem_t *left, int left_height, avl_elem_t *right,
+                         int right_height, int *pheight)
+{
+    if (!left) {
+        *pheight = right_height;
+        return right;
+    }
+    avl_elem_t *rest;
+    int rest_height;
+    avl_elem_t *last = split_last(left, left_height, &rest, &rest_height);
+    return join(rest, rest_height, last, right, right_height, pheight);
+}
+
+static void set_root(avl_tree_t *tree, avl_elem_t *root)
+{
+    tree->root = orphan(root);
+    tree->size = count_of(root);
+}
+
+avl_tree_t *avl_tree_split(avl_tree_t *tree, const void *key)
+{
+    avl_tree_t *upper = make_avl_tree_2(tree->cmp, tree->obj);
+    avl_elem_t *left, *right;
+    int left_height, right_height;
+    avl_elem_t *found =
+        split(tree, orphan(tree->root), subtree_height(tree->root), key,
+              &left, &left_height, &right, &right_height);
+    if (found)
+        right = join(NULL, 0, found, right, right_height, &right_height);
+    set_root(tree, left);
+    set_root(upper, right);
+    return upper;
+}
+
+void avl_tree_join(avl_tree_t *tree1, avl_tree_t *tree2)
+{
+    int height;
+    set_root(tree1, join2(tree1->root, subtree_height(tree1->root),
+                          tree2->root, subtree_height(tree2->root),
+                          &height));
+    set_root(tree2, NULL);
+}
+
+typedef struct {
+    avl_tree_t *tree;
+    void (*discard)(const void *key, const void *value, void *arg);
+    void *arg;
+} set_operation_t;
+
+static void discard_element(set_operation_t *op, avl_elem_t *element)
+{
+    if (op->discard)
+        op->discard(element->key, element->value, op->arg);
+    destroy_avl_element(element);
+}
+
+static void discard_subtree(set_operation_t *op, avl_elem_t *element)
+{
+    if (element) {
+        discard_subtree(op, element->left);
+        discard_subtree(op, element->right);
+        discard_element(op, element);
+    }
+}
+
+/* The set operations split t2 at the root of t1 and recurse on the
+ * matching halves. */
+static avl_elem_t *unite(set_operation_t *op, avl_elem_t *t1, int h1,
+                         avl_elem_t *t2, int h2, int *pheight)
+{
+    if (!t1 || !t2) {
+        *pheight = t1 ? h1 : h2;
+        return t1 ? t1 : t2;
+    }
+    avl_elem_t *left1 = orphan(t1->left), *right1 = orphan(t1->right);
+    int lh1 = height_of_left(t1, h1), rh1 = height_of_right(t1, h1);
+    avl_elem_t *left2, *right2;
+    int lh2, rh2;
+    avl_elem_t *found =
+        split(op->tree, t2, h2, t1->key, &left2, &lh2, &right2, &rh2);
+    if (found)
+        discard_element(op, found);
+    int lh, rh;
+    avl_elem_t *left = unite(op, left1, lh1, left2, lh2, &lh);
+    avl_elem_t *right = unite(op, right1, rh1, right2, rh2, &rh);
+    return join(left, lh, t1, right, rh, pheight);
+}
+
+static avl_elem_t *intersect(set_operation_t *op, avl_elem_t *t1, int h1,
+                             avl_elem_t *t2, int h2, int *pheight)
+{
+    if (!t1 || !t2) {
+        discard_subtree(op, t1);
+        discard_subtree(op, t2);
+        *pheight = 0;
+        return NULL;
+    }
+    avl_elem_t *left1 = orphan(t1->left), *right1 = orphan(t1->right);
+    int lh1 = height_of_left(t1, h1), rh1 = height_of_right(t1, h1);
+    avl_elem_t *left2, *right2;
+    int lh2, rh2;
+    avl_elem_t *found =
+        split(op->tree, t2, h2, t1->key, &left2, &lh2, &right2, &rh2);
+    int lh, rh;
+    avl_elem_t *left = intersect(op, left1, lh1, left2, lh2, &lh);
+    avl_elem_t *right = intersect(op, right1, rh1, right2, rh2, &rh);
+    if (found) {
+        discard_element(op, found);
+        return join(left, lh, t1, right, rh, pheight);
+    }
+    discard_element(op, t1);
+    return join2(left, lh, right, rh, pheight);
+}
+
+static avl_elem_t *subtract(set_operation_t *op, avl_elem_t *t1, int h1,
+                            avl_elem_t *t2, int h2, int *pheight)
+{
+    if (!t1 || !t2) {
+        discard_subtree(op, t2);
+        *pheight = t1 ? h1 : 0;
+        return t1;
+    }
+    avl_elem_t *left1 = orphan(t1->left), *right1 = orphan(t1->right);
+    int lh1 = height_of_left(t1, h1), rh1 = height_of_right(t1, h1);
+    avl_elem_t *left2, *right2;
+    int lh2, rh2;
+    avl_elem_t *found =
+        split(op->tree, t2, h2, t1->key, &left2, &lh2, &right2, &rh2);
+    int lh, rh;
+    avl_elem_t *left = subtract(op, left1, lh1, left2, lh2, &lh);
+    avl_elem_t *right = subtract(op, right1, rh1, right2, rh2, &rh);
+    if (found) {
+        discard_element(op, found);
+        discard_element(op, t1);
+        return join2(left, lh, right, rh, pheight);
+    }
+    return join(left, lh, t1, right, rh, pheight);
+}
+
+static void combine(avl_tree_t *tree1, avl_tree_t *tree2,
+                    avl_elem_t *(*operation)(set_operation_t *, avl_elem_t *,
+                                             int, avl_elem_t *, int, int *),
+                    void (*discard)(const void *, const void *, void *),
+                    void *arg)
+{
+    set_operation_t op = {
+        .tree = tree1,
+        .discard = discard,
+        .arg = arg,
+    };
+    int height;
+    set_root(tree1, operation(&op, tree1->root, subtree_height(tree1->root),
+                              tree2->root, subtree_height(tree2->root),
+                              &height));
+    set_root(tree2, NULL);
+}
+
+void avl_tree_union(avl_tree_t *tree1, avl_tree_t *tree2,
+                    void (*discard)(const void *key, const void *value,
+                                    void *arg),
+                    void *arg)
+{
+    combine(tree1, tree2, unite, discard, arg);
+}
+
+void avl_tree_intersection(avl_tree_t *tree1, avl_tree_t *tree2,
+                           void (*discard)(const void *key, const void *value,
+                                           void *arg),
+                           void *arg)
+{
+    combine(tree1, tree2, intersect, discard, arg);
+}
+
+void avl_tree_difference(avl_tree_t *tree1, avl_tree_t *tree2,
+                         void (*discard)(const void *key, const void *value,
+                                         void *arg),
+                         void *arg)
+{
+    combine(tree1, tree2, subtract, discard, arg);
+}
+
+size_t avl_tree_count_range(avl_tree_t *tree, const void *lo, const void *hi)
+{
+    if (tree->cmp(lo, hi, tree->obj) >= 0)
+        return 0;
+    return avl_tree_rank(tree, hi) - avl_tree_rank(tree, lo);
+}
+
+size_t avl_tree_remove_range(avl_tree_t *tree, const void *lo, const void *hi,
+                             void (*cb)(const void *key, const void *value,
+                                        void *arg),
+                             void *arg)
+{
+    if (tree->cmp(lo, hi, tree->obj) >= 0)
+        return 0;
+    avl_elem_t *below, *rest, *range, *above;
+    int below_height, rest_height, range_height, above_height, height;
+    avl_elem_t *first =
+        split(tree, orphan(tree->root), subtree_height(tree->root), lo,
+              &below, &below_height, &rest, &rest_height);
+    avl_elem_t *bound = split(tree, rest, rest_height, hi, &range,
+                              &range_height, &above, &above_height);
+    if (bound)
+        set_root(tree, join(below, below_height, bound, above, above_height,
+                            &height));
+    else
+        set_root(tree, join2(below, below_height, above, above_height,
+                             &height));
+    size_t removed = count_of(range);
+    if (first) {
+        removed++;
+        release_subtree(first, cb, arg);
+    }
+    release_subtree(range, cb, arg);
+    return removed;
+}
@@ -0,0 +1,546 @@
+#include "btree.h"
+
+#include <string.h>
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+enum {
+    LEAF_CAPACITY = 32,
+    MIN_LEAF = LEAF_CAPACITY / 2,
+    FANOUT = 32,
+    MIN_FANOUT = FANOUT / 2,
+    MAX_HEIGHT = 32,
+};
+
+typedef struct btree_leaf btree_leaf_t;
+
+struct btree_elem {
+    const void *key, *value;
+    btree_leaf_t *leaf;
+};
+
+/* The leaves are linked in key order. Every leaf but the root holds at
+ * least MIN_LEAF elements. */
+struct btree_leaf {
+    unsigned count;
+    btree_leaf_t *previous, *next;
+    btree_elem_t elems[LEAF_CAPACITY];
+};
+
+/* keys[i] (0 < i < count) is the first key in the subtree of
+ * children[i], so every separator refers to a key in the tree. Every
+ * inner node but the root has at least MIN_FANOUT children. */
+typedef struct {
+    unsigned count;
+    const void *keys[FANOUT];
+    void *children[FANOUT];
+} btree_inner_t;
+
+struct btree {
+    int (*cmp)(const void *, const void *, void *);
+    void *obj;
+    void *root; /* a leaf if height is 0 */
+    unsigned height;
+    size_t size;
+    btree_leaf_t *first, *last;
+};
+
+/* The inner nodes from the root down to a leaf and the child index
+ * taken at each. */
+typedef struct {
+    btree_inner_t *nodes[MAX_HEIGHT];
+    unsigned indices[MAX_HEIGHT];
+} btree_path_t;
+
+btree_t *make_btree_2(int (*cmp)(const void *, const void *, void *),
+                      void *obj)
+{
+    btree_t *tree = fsalloc(sizeof *tree);
+    tree->cmp = cmp;
+    tree->obj = obj;
+    tree->root = NULL;
+    tree->height = 0;
+    tree->size = 0;
+    tree->first = tree->last = NULL;
+    return tree;
+}
+
+btree_t *make_btree(int (*cmp)(const void *, const void *))
+{
+    return make_btree_2((void *) cmp, NULL);
+}
+
+static void destroy_node(void *node, unsigned height)
+{
+    if (height > 0) {
+        btree_inner_t *inner = node;
+        unsigned i;
+        for (i = 0; i < inner->count; i++)
+            destroy_node(inner->children[i], height - 1);
+    }
+    fsfree(node);
+}
+
+void destroy_btree(btree_t *tree)
+{
+    if (tree->root)
+        destroy_node(tree->root, tree->height);
+    fsfree(tree);
+}
+
+size_t btree_size(btree_t *tree)
+{
+    return tree->size;
+}
+
+int btree_empty(btree_t *tree)
+{
+    return tree->root == NULL;
+}
+
+const void *btree_elem_get_key(btree_elem_t *element)
+{
+    return element->key;
+}
+
+const void *btree_elem_get_value(btree_elem_t *element)
+{
+    return element->value;
+}
+
+static int compare(btree_t *tree, const void *key1, const void *key2)
+{
+    return tree->cmp(key1, key2, tree->obj);
+}
+
+/* Return the index of the child whose subtree would contain key. */
+static unsigned child_index(btree_t *tree, btree_inner_t *node,
+                            const void *key)
+{
+    unsigned low = 1, high = node->count;
+    while (low < high) {
+        unsigned middle = (low + high) / 2;
+        if (compare(tree, key, node->keys[middle]) < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low - 1;
+}
+
+/* Return the index of the first element whose key is greater than or
+ * equal to key (or greater than key if after is true). */
+static unsigned leaf_index(btree_t *tree, btree_leaf_t *leaf, const void *key,
+                           bool after)
+{
+    unsigned low = 0, high = leaf->count;
+    while (low < high) {
+        unsigned middle = (low + high) / 2;
+        int cmp = compare(tree, key, leaf->elems[middle].key);
+        if (cmp > 0 || (after && cmp == 0))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+static btree_leaf_t *descend(btree_t *tree, const void *key,
+                             btree_path_t *path)
+{
+    void *node = tree->root;
+    unsigned level;
+    for (level = 0; level < tree->height; level++) {
+        btree_inner_t *inner = node;
+        unsigned i = child_index(tree, inner, key);
+        if (path) {
+            path->nodes[level] = inner;
+            path->indices[level] = i;
+        }
+        node = inner->children[i];
+    }
+    return node;
+}
+
+/* Return the element at index i or, if i is past the end of the leaf,
+ * the first element of the next leaf. */
+static btree_elem_t *element_at(btree_leaf_t *leaf, unsigned i)
+{
+    if (i < leaf->count)
+        return &leaf->elems[i];
+    leaf = leaf->next;
+    return leaf ? &leaf->elems[0] : NULL;
+}
+
+/* Return the element preceding index i, which may be in the previous
+ * leaf. */
+static btree_elem_t *element_before(btree_leaf_t *leaf, unsigned i)
+{
+    if (i > 0)
+        return &leaf->elems[i - 1];
+    leaf = leaf->previous;
+    return leaf ? &leaf->elems[leaf->count - 1] : NULL;
+}
+
+btree_elem_t *btree_get(btree_t *tree, const void *key)
+{
+    if (!tree->root)
+        return NULL;
+    btree_leaf_t *leaf = descend(tree, key, NULL);
+    unsigned i = leaf_index(tree, leaf, key, false);
+    if (i < leaf->count && compare(tree, key, leaf->elems[i].key) == 0)
+        return &leaf->elems[i];
+    return NULL;
+}
+
+btree_elem_t *btree_get_before(btree_t *tree, const void *key)
+{
+    if (!tree->root)
+        return NULL;
+    btree_leaf_t *leaf = descend(tree, key, NULL);
+    return element_before(leaf, leaf_index(tree, leaf, key, false));
+}
+
+btree_elem_t *btree_get_on_or_before(btree_t *tree, const void *key)
+{
+    if (!tree->root)
+        return NULL;
+    btree_leaf_t *leaf = descend(tree, key, NULL);
+    return element_before(leaf, leaf_index(tree, leaf, key, true));
+}
+
+btree_elem_t *btree_get_after(btree_t *tree, const void *key)
+{
+    if (!tree->root)
+        return NULL;
+    btree_leaf_t *leaf = descend(tree, key, NULL);
+    return element_at(leaf, leaf_index(tree, leaf, key, true));
+}
+
+btree_elem_t *btree_get_on_or_after(btree_t *tree, const void *key)
+{
+    if (!tree->root)
+        return NULL;
+    btree_leaf_t *leaf = descend(tree, key, NULL);
+    return element_at(leaf, leaf_index(tree, leaf, key, false));
+}
+
+btree_elem_t *btree_get_first(btree_t *tree)
+{
+    return tree->first ? &tree->first->elems[0] : NULL;
+}
+
+btree_elem_t *btree_get_last(btree_t *tree)
+{
+    return tree->last ? &tree->last->elems[tree->last->count - 1] : NULL;
+}
+
+btree_elem_t *btree_next(btree_elem_t *element)
+{
+    btree_leaf_t *leaf = element->leaf;
+    return element_at(leaf, element - leaf->elems + 1);
+}
+
+btree_elem_t *btree_previous(btree_elem_t *element)
+{
+    btree_leaf_t *leaf = element->leaf;
+    return element_before(leaf, element - leaf->elems);
+}
+
+static btree_leaf_t *make_leaf(void)
+{
+    btree_leaf_t *leaf = fsalloc(sizeof *leaf);
+    leaf->count = 0;
+    leaf->previous = leaf->next = NULL;
+    return leaf;
+}
+
+/* Move n elements within a leaf or from one leaf to another. */
+static void move_elements(btree_leaf_t *to, unsigned to_index,
+                          btree_leaf_t *from, unsigned from_index, unsigned n)
+{
+    memmove(&to->elems[to_index], &from->elems[from_index],
+            n * sizeof to->elems[0]);
+    if (to != from) {
+        unsigned i;
+        for (i = to_index; i < to_index + n; i++)
+            to->elems[i].leaf = to;
+    }
+}
+
+/* The first key of a leaf is the separator of the lowest ancestor
+ * whose subtree the leaf is not the first leaf of. */
+static void replace_separator(btree_t *tree, btree_path_t *path,
+                              const void *key)
+{
+    unsigned level = tree->height;
+    while (level-- > 0)
+        if (path->indices[level] > 0) {
+            path->nodes[level]->keys[path->indices[level]] = key;
+            return;
+        }
+}
+
+/* Insert key and child to the right of the child taken at the given
+ * level of path, splitting nodes upwards as needed. */
+static void insert_child(btree_t *tree, btree_path_t *path, int level,
+                         const void *key, void *child)
+{
+    for (; level >= 0; level--) {
+        btree_inner_t *node = path->nodes[level];
+        unsigned i = path->indices[level] + 1;
+        if (node->count < FANOUT) {
+            memmove(&node->keys[i + 1], &node->keys[i],
+                    (node->count - i) * sizeof node->keys[0]);
+            memmove(&node->children[i + 1], &node->children[i],
+                    (node->count - i) * sizeof node->children[0]);
+            node->keys[i] = key;
+            node->children[i] = child;
+            node->count++;
+            return;
+        }
+        const void *keys[FANOUT + 1];
+        void *children[FANOUT + 1];
+        memcpy(keys, node->keys, i * sizeof keys[0]);
+        memcpy(children, node->children, i * sizeof children[0]);
+        keys[i] = key;
+        children[i] = child;
+        memcpy(&keys[i + 1], &node->keys[i], (FANOUT - i) * sizeof keys[0]);
+        memcpy(&children[i + 1], &node->children[i],
+               (FANOUT - i) * sizeof children[0]);
+        unsigned half = (FANOUT + 1) / 2;
+        btree_inner_t *right = fsalloc(sizeof *right);
+        right->count = FANOUT + 1 - half;
+        memcpy(&right->keys[1], &keys[half + 1],
+               (right->count - 1) * sizeof keys[0]);
+        memcpy(right->children, &children[half],
+               right->count * sizeof children[0]);
+        node->count = half;
+        memcpy(node->keys, keys, half * sizeof keys[0]);
+        memcpy(node->children, children, half * sizeof children[0]);
+        key = keys[half];
+        child = right;
+    }
+    btree_inner_t *root = fsalloc(sizeof *root);
+    root->count = 2;
+    root->children[0] = tree->root;
+    root->keys[1] = key;
+    root->children[1] = child;
+    tree->root = root;
+    tree->height++;
+}
+
+static void split_leaf(btree_t *tree, btree_path_t *path, btree_leaf_t *leaf)
+{
+    btree_leaf_t *right = make_leaf();
+    unsigned half = LEAF_CAPACITY / 2;
+    right->count = LEAF_CAPACITY - half;
+    move_elements(right, 0, leaf, half, right->count);
+    leaf->count = half;
+    right->previous = leaf;
+    right->next = leaf->next;
+    if (leaf->next)
+        leaf->next->previous = right;
+    else
+        tree->last = right;
+    leaf->next = right;
+    insert_child(tree, path, (int) tree->height - 1, right->elems[0].key,
+                 right);
+}
+
+bool btree_put(btree_t *tree, const void *key, const void *value,
+               const void **pold_key, const void **pold_value)
+{
+    if (!tree->root)
+        tree->root = tree->first = tree->last = make_leaf();
+    btree_path_t path;
+    btree_leaf_t *leaf = descend(tree, key, &path);
+    unsigned i = leaf_index(tree, leaf, key, false);
+    if (i < leaf->count && compare(tree, key, leaf->elems[i].key) == 0) {
+        btree_elem_t *element = &leaf->elems[i];
+        if (pold_key)
+            *pold_key = element->key;
+        if (pold_value)
+            *pold_value = element->value;
+        if (i == 0)
+            replace_separator(tree, &path, key);
+        element->key = key;
+        element->value = value;
+        return true;
+    }
+    if (leaf->count == LEAF_CAPACITY) {
+        split_leaf(tree, &path, leaf);
+        if (i > leaf->count) {
+            i -= leaf->count;
+            leaf = leaf->next;
+        }
+    }
+    move_elements(leaf, i + 1, leaf, i, leaf->count - i);
+    leaf->elems[i].key = key;
+    leaf->elems[i].value = value;
+    leaf->elems[i].leaf = leaf;
+    leaf->count++;
+    tree->size++;
+    return false;
+}
+
+static void rebalance_inner(btree_t *tree, btree_path_t *path, int level);
+
+/* Remove the child at index i of the node at the given level of path. */
+static void remove_child(btree_t *tree, btree_path_t *path, int level,
+                         unsigned i)
+{
+    btree_inner_t *node = path->nodes[level];
+    memmove(&node->keys[i], &node->keys[i + 1],
+            (node->count - i - 1) * sizeof node->keys[0]);
+    memmove(&node->children[i], &node->children[i + 1],
+            (node->count - i - 1) * sizeof node->children[0]);
+    node->count--;
+    if (level > 0) {
+        if (node->count < MIN_FANOUT)
+            rebalance_inner(tree, path, level);
+    } else if (node->count == 1) {
+        tree->root = node->children[0];
+        tree->height--;
+        fsfree(node);
+    }
+}
+
+static void merge_inner(btree_inner_t *left, const void *separator,
+                        btree_inner_t *right)
+{
+    left->keys[left->count] = separator;
+    memcpy(&left->keys[left->count + 1], &right->keys[1],
+           (right->count - 1) * sizeof left->keys[0]);
+    memcpy(&left->children[left->count], right->children,
+           right->count * sizeof left->children[0]);
+    left->count += right->count;
+    fsfree(right);
+}
+
+/* Refill an inner node from a sibling or merge it with one. */
+static void rebalance_inner(btree_t *tree, btree_path_t *path, int level)
+{
+    btree_inner_t *node = path->nodes[level];
+    btree_inner_t *parent = path->nodes[level - 1];
+    unsigned j = path->indices[level - 1];
+    if (j + 1 < parent->count) {
+        btree_inner_t *right = parent->children[j + 1];
+        if (right->count > MIN_FANOUT) {
+            node->keys[node->count] = parent->keys[j + 1];
+            node->children[node->count++] = right->children[0];
+            parent->keys[j + 1] = right->keys[1];
+            memmove(&right->keys[1], &right->keys[2],
+                    (right->count - 2) * sizeof right->keys[0]);
+            memmove(&right->children[0], &right->children[1],
+                    (right->count - 1) * sizeof right->children[0]);
+            right->count--;
+            return;
+        }
+        merge_inner(node, parent->keys[j + 1], right);
+        remove_child(tree, path, level - 1, j + 1);
+        return;
+    }
+    btree_inner_t *left = parent->children[j - 1];
+    if (left->count > MIN_FANOUT) {
+        memmove(&node->keys[2], &node->keys[1],
+                (node->count - 1) * sizeof node->keys[0]);
+        memmove(&node->children[1], &node->children[0],
+                node->count * sizeof node->children[0]);
+        node->keys[1] = parent->keys[j];
+        node->children[0] = left->children[--left->count];
+        parent->keys[j] = left->keys[left->count];
+        node->count++;
+        return;
+    }
+    merge_inner(left, parent->keys[j], node);
+    remove_child(tree, path, level - 1, j);
+}
+
+static void merge_leaves(btree_t *tree, btree_leaf_t *left,
+                         btree_leaf_t *right)
+{
+    move_elements(left, left->count, right, 0, right->count);
+    left->count += right->count;
+    left->next = right->next;
+    if (right->next)
+        right->next->previous = left;
+    else
+        tree->last = left;
+    fsfree(right);
+}
+
+/* Refill a leaf from a sibling or merge it with one. */
+static void rebalance_leaf(btree_t *tree, btree_path_t *path,
+                           btree_leaf_t *leaf)
+{
+    int level = tree->height - 1;
+    btree_inner_t *parent = path->nodes[level];
+    unsigned j = path->indices[level];
+    if (j + 1 < parent->count) {
+        btree_leaf_t *right = parent->children[j + 1];
+        if (right->count > MIN_LEAF) {
+            move_elements(leaf, leaf->count++, right, 0, 1);
+            move_elements(right, 0, right, 1, --right->count);
+            parent->keys[j + 1] = right->elems[0].key;
+            return;
+        }
+        merge_leaves(tree, leaf, right);
+        remove_child(tree, path, level, j + 1);
+        return;
+    }
+    btree_leaf_t *left = parent->children[j - 1];
+    if (left->count > MIN_LEAF) {
+        move_elements(leaf, 1, leaf, 0, leaf->count++);
+        move_elements(leaf, 0, left, --left->count, 1);
+        parent->keys[j] = leaf->elems[0].key;
+        return;
+    }
+    merge_leaves(tree, left, leaf);
+    remove_child(tree, path, level, j);
+}
+
+bool btree_pop(btree_t *tree, const void *key, const void **pkey,
+               const void **pvalue)
+{
+    if (!tree->root)
+        return false;
+    btree_path_t path;
+    btree_leaf_t *leaf = descend(tree, key, &path);
+    unsigned i = leaf_index(tree, leaf, key, false);
+    if (i == leaf->count || compare(tree, key, leaf->elems[i].key) != 0)
+        return false;
+    if (pkey)
+        *pkey = leaf->elems[i].key;
+    if (pvalue)
+        *pvalue = leaf->elems[i].value;
+    move_elements(leaf, i, leaf, i + 1, leaf->count - i - 1);
+    leaf->count--;
+    tree->size--;
+    if (tree->height == 0) {
+        if (leaf->count == 0) {
+            fsfree(leaf);
+            tree->root = tree->first = tree->last = NULL;
+        }
+        return true;
+    }
+    /* The removed key may be in use as a separator. */
+    if (i == 0)
+        replace_separator(tree, &path, leaf->elems[0].key);
+    if (leaf->count < MIN_LEAF)
+        rebalance_leaf(tree, &path, leaf);
+    return true;
+}
+
+bool btree_pop_first(btree_t *tree, const void **pkey, const void **pvalue)
+{
+    btree_elem_t *element = btree_get_first(tree);
+    return element && btree_pop(tree, element->key, pkey, pvalue);
+}
+
+bool btree_pop_last(btree_t *tree, const void **pkey, const void **pvalue)
+{
+    btree_elem_t *element = btree_get_last(tree);
+    return element && btree_pop(tree, element->key, pkey, pvalue);
+}
@@ -0,0 +1,319 @@
+#include "chashtable.h"
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+#include "spinlock.h"
+
+enum {
+    EMPTY = 0,
+    MIN_CAPACITY = 8,
+    CACHE_LINE = 64,
+};
+
+/* A slot is EMPTY or holds the (nonzero) scrambled key hash of the
+ * element in it. The shards use linear probing with backward-shift
+ * deletion so there are no tombstones. */
+typedef struct {
+    size_t tag;
+    const void *key, *value;
+} chash_slot_t;
+
+typedef struct chash_array chash_array_t;
+
+/* Readers may still be probing an array after it has been replaced by
+ * a larger one, so replaced arrays are only freed when the table is
+ * destroyed. Their combined size is less than that of the current
+ * array. */
+struct chash_array {
+    size_t capacity;
+    chash_array_t *retired;
+    chash_slot_t slots[];
+};
+
+/* The sequence counter is odd while the shard is being modified. Each
+ * shard occupies a cache line of its own. */
+typedef struct {
+    unsigned sequence;
+    spinlock_t lock;
+    chash_array_t *array;
+    size_t size;
+    char padding[CACHE_LINE - 2 * sizeof(unsigned) - sizeof(void *) -
+                 sizeof(size_t)];
+} shard_t;
+
+struct chash_table {
+    uint64_t (*hash)(const void *);
+    int (*cmp)(const void *, const void *);
+    unsigned shard_bits;
+    void *shard_memory;
+    shard_t *shards;
+};
+
+static uint64_t scramble(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static size_t max_load(size_t capacity)
+{
+    return capacity / 4 * 3;
+}
+
+static chash_array_t *make_array(size_t capacity)
+{
+    chash_array_t *array =
+        fscalloc(1, sizeof *array + capacity * sizeof array->slots[0]);
+    array->capacity = capacity;
+    array->retired = NULL;
+    return array;
+}
+
+chash_table_t *make_chash_table(size_t capacity, unsigned shards,
+                                uint64_t (*hash)(const void *),
+                                int (*cmp)(const void *, const void *))
+{
+    chash_table_t *table = fsalloc(sizeof *table);
+    table->hash = hash;
+    table->cmp = cmp;
+    table->shard_bits = 0;
+    while ((1U << table->shard_bits) < shards && table->shard_bits < 16)
+        table->shard_bits++;
+    unsigned n = 1U << table->shard_bits;
+    table->shard_memory = fsalloc(n * sizeof(shard_t) + CACHE_LINE - 1);
+    table->shards = (shard_t *) (((uintptr_t) table->shard_memory +
+                                  CACHE_LINE - 1) &
+                                 ~(uintptr_t) (CACHE_LINE - 1));
+    size_t shard_capacity = MIN_CAPACITY;
+    while (max_load(shard_capacity) < capacity / n)
+        shard_capacity *= 2;
+    unsigned i;
+    for (i = 0; i < n; i++) {
+        shard_t *shard = &table->shards[i];
+        shard->sequence = 0;
+        spinlock_init(&shard->lock);
+        shard->array = make_array(shard_capacity);
+        shard->size = 0;
+    }
+    return table;
+}
+
+void destroy_chash_table(chash_table_t *table)
+{
+    unsigned i;
+    for (i = 0; i < 1U << table->shard_bits; i++) {
+        chash_array_t *array = table->shards[i].array;
+        while (array) {
+            chash_array_t *retired = array->retired;
+            fsfree(array);
+            array = retired;
+        }
+    }
+    fsfree(table->shard_memory);
+    fsfree(table);
+}
+
+size_t chash_table_size(chash_table_t *table)
+{
+    size_t size = 0;
+    unsigned i;
+    for (i = 0; i < 1U << table->shard_bits; i++)
+        size += __atomic_load_n(&table->shards[i].size, __ATOMIC_RELAXED);
+    return size;
+}
+
+static shard_t *get_shard(chash_table_t *table, const void *key,
+                          size_t *ptag)
+{
+    uint64_t scrambled = scramble(table->hash(key));
+    size_t tag = (size_t) scrambled;
+    *ptag = tag ? tag : 1;
+    if (!table->shard_bits)
+        return table->shards;
+    return &table->shards[scrambled >> (64 - table->shard_bits)];
+}
+
+bool chash_table_get(chash_table_t *table, const void *key,
+                     const void **pvalue)
+{
+    size_t tag;
+    shard_t *shard = get_shard(table, key, &tag);
+    unsigned spins = 0;
+    for (;;) {
+        unsigned sequence =
+            __atomic_load_n(&shard->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            if (++spins == SPINLOCK_SPINS) {
+                sched_yield();
+                spins = 0;
+            }
+            continue;
+        }
+        chash_array_t *array = __atomic_load_n(&shard->array, __ATOMIC_ACQUIRE);
+        size_t mask = array->capacity - 1;
+        size_t i = tag & mask;
+        bool found = false;
+        const void *value = NULL;
+        size_t n;
+        for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+            chash_slot_t *slot = &array->slots[i];
+            size_t slot_tag = __atomic_load_n(&slot->tag, __ATOMIC_RELAXED);
+            if (slot_tag == EMPTY)
+                break;
+            if (slot_tag == tag &&
+                table->cmp(key, __atomic_load_n(&slot->key,
+                                                __ATOMIC_RELAXED)) == 0) {
+                value = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+                found = true;
+                break;
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shard->sequence, __ATOMIC_RELAXED) == sequence) {
+            if (found && pvalue)
+                *pvalue = value;
+            return found;
+        }
+    }
+}
+
+static void begin_write(shard_t *shard)
+{
+    __atomic_store_n(&shard->sequence, shard->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_write(shard_t *shard)
+{
+    __atomic_store_n(&shard->sequence, shard->sequence + 1, __ATOMIC_RELEASE);
+}
+
+static void store_slot(chash_slot_t *slot, size_t tag, const void *key,
+                       const void *value)
+{
+    __atomic_store_n(&slot->key, key, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->value, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->tag, tag, __ATOMIC_RELAXED);
+}
+
+/* Return the slot of the element with the given key or the EMPTY slot
+ * where it should be inserted. The caller must hold the shard lock. */
+static chash_slot_t *find_slot(chash_table_t *table, chash_array_t *array,
+                               const void *key, size_t tag)
+{
+    size_t mask = array->capacity - 1;
+    size_t i;
+    for (i = tag & mask;; i = (i + 1) & mask) {
+        chash_slot_t *slot = &array->slots[i];
+        if (slot->tag == EMPTY ||
+            (slot->tag == tag && table->cmp(key, slot->key) == 0))
+            return slot;
+    }
+}
+
+static void insert(chash_array_t *array, size_t tag, const void *key,
+                   const void *value)
+{
+    size_t mask = array->capacity - 1;
+    size_t i;
+    for (i = tag & mask; array->slots[i].tag != EMPTY; i = (i + 1) & mask)
+        ;
+    store_slot(&array->slots[i], tag, key, value);
+}
+
+/* The new array is filled in before it is published so readers can
+ * keep using the old array in the meanwhile. */
+static void grow(shard_t *shard)
+{
+    chash_array_t *old = shard->array;
+    chash_array_t *array = make_array(2 * old->capacity);
+    size_t i;
+    for (i = 0; i < old->capacity; i++) {
+        chash_slot_t *slot = &old->slots[i];
+        if (slot->tag != EMPTY)
+            insert(array, slot->tag, slot->key, slot->value);
+    }
+    array->retired = old;
+    begin_write(shard);
+    __atomic_store_n(&shard->array, array, __ATOMIC_RELEASE);
+    end_write(shard);
+}
+
+bool chash_table_put(chash_table_t *table, const void *key,
+                     const void *value, const void **pold_key,
+                     const void **pold_value)
+{
+    size_t tag;
+    shard_t *shard = get_shard(table, key, &tag);
+    spinlock_acquire(&shard->lock);
+    chash_slot_t *slot = find_slot(table, shard->array, key, tag);
+    if (slot->tag != EMPTY) {
+        if (pold_key)
+            *pold_key = slot->key;
+        if (pold_value)
+            *pold_value = slot->value;
+        begin_write(shard);
+        store_slot(slot, tag, key, value);
+        end_write(shard);
+        spinlock_release(&shard->lock);
+        return true;
+    }
+    if (shard->size + 1 > max_load(shard->array->capacity)) {
+        grow(shard);
+        slot = find_slot(table, shard->array, key, tag);
+    }
+    begin_write(shard);
+    store_slot(slot, tag, key, value);
+    __atomic_store_n(&shard->size, shard->size + 1, __ATOMIC_RELAXED);
+    end_write(shard);
+    spinlock_release(&shard->lock);
+    return false;
+}
+
+/* Close the gap left by a removed element by moving back the following
+ * elements whose probe sequence passes over the gap. */
+static void delete_slot(chash_array_t *array, size_t i)
+{
+    size_t mask = array->capacity - 1;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        chash_slot_t *slot = &array->slots[j];
+        if (slot->tag == EMPTY)
+            break;
+        size_t home = slot->tag & mask;
+        if (i <= j ? i < home && home <= j : i < home || home <= j)
+            continue;
+        store_slot(&array->slots[i], slot->tag, slot->key, slot->value);
+        i = j;
+    }
+    __atomic_store_n(&array->slots[i].tag, EMPTY, __ATOMIC_RELAXED);
+}
+
+bool chash_table_pop(chash_table_t *table, const void *key,
+                     const void **pkey, const void **pvalue)
+{
+    size_t tag;
+    shard_t *shard = get_shard(table, key, &tag);
+    spinlock_acquire(&shard->lock);
+    chash_array_t *array = shard->array;
+    chash_slot_t *slot = find_slot(table, array, key, tag);
+    if (slot->tag == EMPTY) {
+        spinlock_release(&shard->lock);
+        return false;
+    }
+    if (pkey)
+        *pkey = slot->key;
+    if (pvalue)
+        *pvalue = slot->value;
+    begin_write(shard);
+    delete_slot(array, slot - array->slots);
+    __atomic_store_n(&shard->size, shard->size - 1, __ATOMIC_RELAXED);
+    end_write(shard);
+    spinlock_release(&shard->lock);
+    return true;
+}
@@ -1,36 +1,221 @@
 #include "hashtable.h"
 
+#include <fcntl.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include "fsalloc.h"
 #include "fsdyn_version.h"
 #include "hashtable_imp.h"
-#include "list.h"
-
-/* Values from: https://planetmath.org/goodhashtableprimes */
-static const size_t GOOD_SIZES[] = {
-    53,        97,        193,       389,       769,        1543,     3079,
-    6151,      12289,     24593,     49157,     98317,      196613,   393241,
-    786433,    1572869,   3145739,   6291469,   12582917,   25165843, 50331653,
-    100663319, 201326611, 402653189, 805306457, 1610612741, 0
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum {
+    EMPTY = 0x80,
+    DELETED = 0xfe,
+};
+
+static const double DEFAULT_MAX_LOAD_FACTOR = 0.875;
+static const double MIN_MAX_LOAD_FACTOR = 0.0625;
+static const double MAX_MAX_LOAD_FACTOR = 0.9375;
+
+/* The minimum number of slots of the previous slot array that are
+ * moved over to the current slot array per insertion during a resize.
+ * If the previous slot array is mostly tombstones, the step is made
+ * larger so the move completes before the current slot array fills
+ * up. */
+enum {
+    REHASH_STEP = 64,
+};
+
+#if defined(__SSE2__)
+
+enum {
+    GROUP_WIDTH = 16,
+    MASK_SHIFT = 0,
+};
+
+typedef uint32_t bitmask_t;
+
+static inline __m128i load_group(const uint8_t *control)
+{
+    return _mm_loadu_si128((const __m128i *) control);
+}
+
+static inline bitmask_t match_tag(const uint8_t *control, uint8_t tag)
+{
+    __m128i group = load_group(control);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+}
+
+static inline bitmask_t match_empty(const uint8_t *control)
+{
+    return match_tag(control, EMPTY);
+}
+
+static inline bitmask_t match_empty_or_deleted(const uint8_t *control)
+{
+    return _mm_movemask_epi8(load_group(control));
+}
+
+#else
+
+/* A portable fallback that processes eight control bytes in a 64-bit
+ * word. match_tag() may report false positives, which only cost an
+ * extra key comparison. */
+
+enum {
+    GROUP_WIDTH = 8,
+    MASK_SHIFT = 3,
 };
 
+typedef uint64_t bitmask_t;
+
+static const uint64_t LSBS = 0x0101010101010101;
+static const uint64_t MSBS = 0x8080808080808080;
+
+static inline uint64_t load_group(const uint8_t *control)
+{
+    uint64_t group;
+    memcpy(&group, control, sizeof group);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    group = __builtin_bswap64(group);
+#endif
+    return group;
+}
+
+static inline bitmask_t match_tag(const uint8_t *control, uint8_t tag)
+{
+    uint64_t x = load_group(control) ^ LSBS * tag;
+    return (x - LSBS) & ~x & MSBS;
+}
+
+static inline bitmask_t match_empty(const uint8_t *control)
+{
+    uint64_t group = load_group(control);
+    return group & ~(group << 6) & MSBS;
+}
+
+static inline bitmask_t match_empty_or_deleted(const uint8_t *control)
+{
+    return load_group(control) & MSBS;
+}
+
+#endif
+
+/* Return the index of the lowest matching control byte and clear it
+ * from the mask. */
+static inline size_t next_match(bitmask_t *mask)
+{
+    size_t i = __builtin_ctzll(*mask) >> MASK_SHIFT;
+    *mask &= *mask - 1;
+    return i;
+}
+
+/* The user-supplied hash function need not scramble the low bits well
+ * (e.g., hash_integer()), so the finalizer of MurmurHash3 is applied
+ * before the hash value is split into a group index and a tag. */
+static inline uint64_t scramble(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static inline uint8_t hash_tag(uint64_t scrambled)
+{
+    return scrambled & 0x7f;
+}
+
+static inline size_t first_group(hash_array_t *array, uint64_t scrambled)
+{
+    return (scrambled >> 7) & (array->capacity / GROUP_WIDTH - 1);
+}
+
+/* Triangular probing visits every group exactly once since the number
+ * of groups is a power of two. */
+static inline size_t next_group(hash_array_t *array, size_t group,
+                                size_t step)
+{
+    return (group + step) & (array->capacity / GROUP_WIDTH - 1);
+}
+
+static inline bool slot_full(hash_array_t *array, size_t slot)
+{
+    return !(array->control[slot] & EMPTY);
+}
+
+static size_t max_load(hash_table_t *table, size_t capacity)
+{
+    return capacity * table->max_load_factor;
+}
+
+static size_t good_capacity(hash_table_t *table, size_t size)
+{
+    size_t capacity = GROUP_WIDTH;
+    while (max_load(table, capacity) < size)
+        capacity *= 2;
+    return capacity;
+}
+
+static void allocate_slots(hash_array_t *array, size_t capacity)
+{
+    array->capacity = capacity;
+    array->size = array->tombstones = 0;
+    array->control = fsalloc(capacity);
+    memset(array->control, EMPTY, capacity);
+    array->slots = fsalloc(capacity * sizeof *array->slots);
+}
+
+static void free_slots(hash_array_t *array)
+{
+    fsfree(array->control);
+    fsfree(array->slots);
+    array->control = NULL;
+    array->slots = NULL;
+    array->capacity = array->size = 0;
+}
+
+static bool resizing(hash_table_t *table)
+{
+    return table->previous.control != NULL;
+}
+
 hash_table_t *make_hash_table(size_t capacity, uint64_t (*hash)(const void *),
                               int (*cmp)(const void *, const void *))
 {
     hash_table_t *table = fsalloc(sizeof *table);
-    const size_t *goodp;
-    for (goodp = GOOD_SIZES; goodp[1] && goodp[0] < capacity; goodp++)
-        ;
-    capacity = *goodp;
-    table->capacity = capacity;
     table->size = 0;
     table->hash = hash;
     table->cmp = cmp;
-    table->table = fscalloc(capacity, sizeof *table->table);
+    table->max_load_factor = DEFAULT_MAX_LOAD_FACTOR;
+    allocate_slots(&table->current, good_capacity(table, capacity));
+    table->previous.control = NULL;
+    table->previous.slots = NULL;
+    table->previous.capacity = table->previous.size = 0;
+    table->rehash_index = table->rehash_step = 0;
+    table->elements = NULL;
+    table->elements_capacity = 0;
     return table;
 }
 
+void hash_table_set_max_load_factor(hash_table_t *table,
+                                    double max_load_factor)
+{
+    if (max_load_factor < MIN_MAX_LOAD_FACTOR)
+        max_load_factor = MIN_MAX_LOAD_FACTOR;
+    else if (max_load_factor > MAX_MAX_LOAD_FACTOR)
+        max_load_factor = MAX_MAX_LOAD_FACTOR;
+    table->max_load_factor = max_load_factor;
+}
+
 void destroy_hash_element(hash_elem_t *element)
 {
     fsfree(element);
@@ -39,26 +224,33 @@ void destroy_hash_element(hash_elem_t *element)
 void destroy_hash_table(hash_table_t *table)
 {
     size_t i;
-    for (i = 0; i < table->capacity; i++)
-        if (table->table[i] != NULL) {
-            list_elem_t *le;
-            for (le = list_get_first(table->table[i]); le; le = list_next(le))
-                destroy_hash_element((hash_elem_t *) list_elem_get_value(le));
-            destroy_list(table->table[i]);
-        }
-    fsfree(table->table);
+    for (i = 0; i < table->size; i++)
+        destroy_hash_element(table->elements[i]);
+    fsfree(table->elements);
+    free_slots(&table->previous);
+    free_slots(&table->current);
     fsfree(table);
 }
 
-static void add_element(hash_table_t *hash_table, size_t list_index,
-                        const void *key, const void *value)
+bool destroy_hash_table_incrementally(hash_table_t *table,
+                                      size_t max_elements,
+                                      void (*cb)(const void *key,
+                                                 const void *value,
+                                                 void *arg),
+                                      void *arg)
 {
-    hash_elem_t *element = fsalloc(sizeof *element);
-    element->key = key;
-    element->value = value;
-    element->hash_table = hash_table;
-    element->list_index = list_index;
-    element->loc = list_append(hash_table->table[list_index], element);
+    /* Take the elements off the end of the dense array; the slots are
+     * never looked at again. */
+    for (; table->size && max_elements; max_elements--) {
+        hash_elem_t *element = table->elements[--table->size];
+        if (cb)
+            cb(element->key, element->value, arg);
+        destroy_hash_element(element);
+    }
+    if (table->size)
+        return false;
+    destroy_hash_table(table);
+    return true;
 }
 
 size_t hash_table_size(hash_table_t *table)
@@ -76,51 +268,202 @@ const void *hash_elem_get_value(hash_elem_t *element)
     return element->value;
 }
 
+static hash_elem_t *find(hash_table_t *table, hash_array_t *array,
+                         const void *key, uint64_t hash, uint64_t scrambled)
+{
+    uint8_t tag = hash_tag(scrambled);
+    size_t group = first_group(array, scrambled);
+    size_t step = 0;
+    for (;;) {
+        const uint8_t *control = array->control + group * GROUP_WIDTH;
+        bitmask_t match = match_tag(control, tag);
+        while (match) {
+            hash_elem_t *element =
+                array->slots[group * GROUP_WIDTH + next_match(&match)];
+            if (element->hash == hash && table->cmp(key, element->key) == 0)
+                return element;
+        }
+        if (match_empty(control))
+            return NULL;
+        group = next_group(array, group, ++step);
+    }
+}
+
+/* Return the first EMPTY or DELETED slot on the probe sequence. */
+static size_t find_free(hash_array_t *array, uint64_t scrambled)
+{
+    size_t group = first_group(array, scrambled);
+    size_t step = 0;
+    for (;;) {
+        bitmask_t match =
+            match_empty_or_deleted(array->control + group * GROUP_WIDTH);
+        if (match)
+            return group * GROUP_WIDTH + next_match(&match);
+        group = next_group(array, group, ++step);
+    }
+}
+
+static void place(hash_array_t *array, hash_elem_t *element,
+                  uint64_t scrambled)
+{
+    size_t slot = find_free(array, scrambled);
+    if (array->control[slot] == DELETED)
+        array->tombstones--;
+    array->control[slot] = hash_tag(scrambled);
+    array->slots[slot] = element;
+    array->size++;
+    element->slot = slot;
+}
+
+/* Move up to n slots of the previous slot array over to the current
+ * slot array. The moved slots are marked DELETED so the probe
+ * sequences of the remaining elements stay intact. */
+static void rehash(hash_table_t *table, size_t n)
+{
+    hash_array_t *previous = &table->previous;
+    size_t end = table->rehash_index + n;
+    if (end > previous->capacity)
+        end = previous->capacity;
+    for (; table->rehash_index < end; table->rehash_index++) {
+        size_t i = table->rehash_index;
+        if (!slot_full(previous, i))
+            continue;
+        hash_elem_t *element = previous->slots[i];
+        place(&table->current, element, scramble(element->hash));
+        previous->control[i] = DELETED;
+        previous->size--;
+    }
+    if (table->rehash_index == previous->capacity)
+        free_slots(previous);
+}
+
+static void rehash_step(hash_table_t *table)
+{
+    if (resizing(table))
+        rehash(table, table->rehash_step);
+}
+
+/* Make room for one more element in the current slot array. If it is
+ * full, a new slot array is allocated, and the elements are moved over
+ * to it gradually. If a large part of the load consists of tombstones,
+ * the new slot array is not larger than the current one.
+ *
+ * The new slot array has room for at least table->size + 1 insertions
+ * besides the moved elements, and the step is chosen so that the move
+ * completes within them. Only if the maximum load factor is lowered
+ * during a resize can the current slot array fill up first; then the
+ * rest of the move is done at once. */
+static void reserve_one(hash_table_t *table)
+{
+    hash_array_t *current = &table->current;
+    if (current->size + current->tombstones <
+        max_load(table, current->capacity))
+        return;
+    if (resizing(table))
+        rehash(table, table->previous.capacity);
+    table->previous = *current;
+    table->rehash_index = 0;
+    allocate_slots(current, good_capacity(table, 2 * (table->size + 1)));
+    size_t room = table->size + 1;
+    table->rehash_step = (table->previous.capacity + room - 1) / room;
+    if (table->rehash_step < REHASH_STEP)
+        table->rehash_step = REHASH_STEP;
+}
+
+static void append_element(hash_table_t *table, hash_elem_t *element)
+{
+    if (table->size == table->elements_capacity) {
+        table->elements_capacity =
+            table->elements_capacity ? 2 * table->elements_capacity : 16;
+        table->elements =
+            fsrealloc(table->elements,
+                      table->elements_capacity * sizeof *table->elements);
+    }
+    element->index = table->size;
+    table->elements[table->size++] = element;
+}
+
+static hash_array_t *array_of(hash_table_t *table, hash_elem_t *element)
+{
+    hash_array_t *previous = &table->previous;
+    size_t slot = element->slot;
+    if (slot < previous->capacity && slot_full(previous, slot) &&
+        previous->slots[slot] == element)
+        return previous;
+    return &table->current;
+}
+
+static hash_elem_t *lookup(hash_table_t *table, const void *key,
+                           uint64_t hash, uint64_t scrambled)
+{
+    hash_elem_t *element = find(table, &table->current, key, hash, scrambled);
+    if (element == NULL && resizing(table))
+        element = find(table, &table->previous, key, hash, scrambled);
+    return element;
+}
+
+hash_elem_t *hash_table_get_hashed(hash_table_t *table, const void *key,
+                                   uint64_t hash)
+{
+    return lookup(table, key, hash, scramble(hash));
+}
+
 hash_elem_t *hash_table_get(hash_table_t *table, const void *key)
 {
-    list_t *list = table->table[table->hash(key) % table->capacity];
-    if (list == NULL)
+    return hash_table_get_hashed(table, key, table->hash(key));
+}
+
+hash_elem_t *hash_table_put_hashed(hash_table_t *table, const void *key,
+                                   const void *value, uint64_t hash)
+{
+    rehash_step(table);
+    uint64_t scrambled = scramble(hash);
+    hash_elem_t *old = lookup(table, key, hash, scrambled);
+    if (old != NULL && old->value == value)
         return NULL;
-    list_elem_t *le;
-    for (le = list_get_first(list); le != NULL; le = list_next(le)) {
-        hash_elem_t *element = (hash_elem_t *) list_elem_get_value(le);
-        if (table->cmp(key, element->key) == 0)
-            return element;
+    hash_elem_t *element = fsalloc(sizeof *element);
+    element->hash_table = table;
+    element->hash = hash;
+    element->key = key;
+    element->value = value;
+    if (old != NULL) {
+        element->slot = old->slot;
+        array_of(table, old)->slots[old->slot] = element;
+        element->index = old->index;
+        table->elements[old->index] = element;
+        return old;
     }
+    reserve_one(table);
+    place(&table->current, element, scrambled);
+    append_element(table, element);
     return NULL;
 }
 
 hash_elem_t *hash_table_put(hash_table_t *table, const void *key,
                             const void *value)
 {
-    size_t i = table->hash(key) % table->capacity;
-    list_t *list = table->table[i];
-    if (list == NULL) {
-        table->table[i] = make_list();
-        add_element(table, i, key, value);
-        table->size++;
-        return NULL;
-    }
-    list_elem_t *le;
-    for (le = list_get_first(list); le != NULL; le = list_next(le)) {
-        hash_elem_t *old = (hash_elem_t *) list_elem_get_value(le);
-        if (table->cmp(key, old->key) == 0) {
-            if (hash_elem_get_value(old) == value)
-                return NULL;
-            list_remove(list, le);
-            add_element(table, i, key, value);
-            return old;
-        }
+    return hash_table_put_hashed(table, key, value, table->hash(key));
+}
+
+/* A slot can be marked EMPTY if its group has an EMPTY slot, since
+ * then no probe sequence has ever continued past the group. */
+static void clear_slot(hash_array_t *array, size_t slot)
+{
+    if (match_empty(array->control + slot / GROUP_WIDTH * GROUP_WIDTH))
+        array->control[slot] = EMPTY;
+    else {
+        array->control[slot] = DELETED;
+        array->tombstones++;
     }
-    add_element(table, i, key, value);
-    table->size++;
-    return NULL;
+    array->size--;
 }
 
 void hash_table_detach(hash_table_t *table, hash_elem_t *element)
 {
-    list_remove(element->hash_table->table[element->list_index], element->loc);
-    table->size--;
+    clear_slot(array_of(table, element), element->slot);
+    hash_elem_t *last = table->elements[--table->size];
+    last->index = element->index;
+    table->elements[last->index] = last;
 }
 
 void hash_table_remove(hash_table_t *table, hash_elem_t *element)
@@ -139,38 +482,29 @@ hash_elem_t *hash_table_pop(hash_table_t *table, const void *key)
 
 hash_elem_t *hash_table_pop_any(hash_table_t *table)
 {
-    size_t i;
-    for (i = 0; i < table->capacity; i++) {
-        list_t *list = table->table[i];
-        if (list != NULL && !list_empty(list)) {
-            table->size--;
-            return (hash_elem_t *) list_pop_first(list);
-        }
-    }
-    return NULL;
-}
-
-static hash_elem_t *get_next(hash_table_t *table, size_t i)
-{
-    for (; i < table->capacity; i++) {
-        list_t *list = table->table[i];
-        if (list != NULL && !list_empty(list))
-            return (hash_elem_t *) list_elem_get_value(list_get_first(list));
-    }
-    return NULL;
+    if (table->size == 0)
+        return NULL;
+    hash_elem_t *element = table->elements[table->size - 1];
+    hash_table_detach(table, element);
+    return element;
 }
 
+/* The traversal walks the dense elements array downward. Detaching an
+ * element moves the last element into its place, and that element has
+ * been visited already, so the traversal survives detaching the
+ * current element. */
 hash_elem_t *hash_table_get_any(hash_table_t *table)
 {
-    return get_next(table, 0);
+    if (table->size == 0)
+        return NULL;
+    return table->elements[table->size - 1];
 }
 
 hash_elem_t *hash_table_get_other(hash_elem_t *element)
 {
-    list_elem_t *le = list_next(element->loc);
-    if (le)
-        return (hash_elem_t *) list_elem_get_value(le);
-    return get_next(element->hash_table, element->list_index + 1);
+    if (element->index == 0)
+        return NULL;
+    return element->hash_table->elements[element->index - 1];
 }
 
 int hash_table_empty(hash_table_t *table)
@@ -204,3 +538,217 @@ uint64_t hash_blob(const void *blob, size_t size)
         hash = hash * 9973 + *p++ + 9999991;
     return hash;
 }
+
+static uint64_t process_seed;
+
+static uint64_t generate_seed(void)
+{
+    uint64_t seed = 0;
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (read(fd, &seed, sizeof seed) != sizeof seed)
+            seed = 0;
+        close(fd);
+    }
+    if (seed == 0) {
+        struct timeval t;
+        gettimeofday(&t, NULL);
+        seed = (uint64_t) t.tv_sec * 1000000 + t.tv_usec;
+        seed ^= (uint64_t) getpid() << 40;
+        seed ^= (uintptr_t) &t;
+        seed = scramble(seed);
+    }
+    return seed ? seed : 1;
+}
+
+/* The seed is generated at load time, while the process is still
+ * single-threaded, unless another constructor happens to need it
+ * first. */
+static __attribute__((constructor)) void init_process_seed(void)
+{
+    if (!process_seed)
+        process_seed = generate_seed();
+}
+
+uint64_t hash_seed(void)
+{
+    if (!process_seed)
+        init_process_seed();
+    return process_seed;
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+/* Compute the 128-bit product of a and b and return its halves in a
+ * and b. */
+static inline void multiply(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = (__uint128_t) *a * *b;
+    *a = product;
+    *b = product >> 64;
+#else
+    uint64_t ha = *a >> 32, la = (uint32_t) *a;
+    uint64_t hb = *b >> 32, lb = (uint32_t) *b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t mid = (ll >> 32) + (uint32_t) hl + (uint32_t) lh;
+    *a = (mid << 32) | (uint32_t) ll;
+    *b = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+}
+
+static inline uint64_t fold(uint64_t a, uint64_t b)
+{
+    multiply(&a, &b);
+    return a ^ b;
+}
+
+/* The algorithm follows wyhash (final version 4) by Wang Yi, which is
+ * in the public domain. */
+static const uint64_t SECRET[4] = {
+    0x2d358dccaa6c78a5,
+    0x8bb84b93962eacc9,
+    0x4b33a62ed433d4a3,
+    0x4d5a2da51de1aa47,
+};
+
+uint64_t hash_blob_seeded(const void *blob, size_t size, uint64_t seed)
+{
+    const uint8_t *p = blob;
+    uint64_t a, b;
+    seed ^= fold(seed ^ SECRET[0], SECRET[1]);
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t offset = (size >> 3) << 2;
+            a = read32(p) << 32 | read32(p + offset);
+            b = read32(p + size - 4) << 32 | read32(p + size - 4 - offset);
+        } else if (size > 0) {
+            a = (uint64_t) p[0] << 16 | (uint64_t) p[size >> 1] << 8 |
+                p[size - 1];
+            b = 0;
+        } else
+            a = b = 0;
+    } else {
+        size_t i = size;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = fold(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+                seed1 =
+                    fold(read64(p + 16) ^ SECRET[2], read64(p + 24) ^ seed1);
+                seed2 =
+                    fold(read64(p + 32) ^ SECRET[3], read64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = fold(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+    a ^= SECRET[1];
+    b ^= seed;
+    multiply(&a, &b);
+    return fold(a ^ SECRET[0] ^ size, b ^ SECRET[1]);
+}
+
+uint64_t hash_string_seeded(const char *s, uint64_t seed)
+{
+    return hash_blob_seeded(s, strlen(s), seed);
+}
+
+uint64_t hash_blob_fast(const void *blob, size_t size)
+{
+    return hash_blob_seeded(blob, size, hash_seed());
+}
+
+uint64_t hash_string_fast(const char *s)
+{
+    return hash_blob_seeded(s, strlen(s), hash_seed());
+}
+
+static inline uint64_t rotl(uint64_t x, int b)
+{
+    return x << b | x >> (64 - b);
+}
+
+static inline void sip_round(uint64_t v[4])
+{
+    v[0] += v[1];
+    v[1] = rotl(v[1], 13);
+    v[1] ^= v[0];
+    v[0] = rotl(v[0], 32);
+    v[2] += v[3];
+    v[3] = rotl(v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = rotl(v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = rotl(v[1], 17);
+    v[1] ^= v[2];
+    v[2] = rotl(v[2], 32);
+}
+
+/* SipHash-2-4 */
+uint64_t hash_blob_keyed(const void *blob, size_t size, const uint8_t key[16])
+{
+    const uint8_t *p = blob;
+    uint64_t k0 = read64(key), k1 = read64(key + 8);
+    uint64_t v[4] = {
+        k0 ^ 0x736f6d6570736575,
+        k1 ^ 0x646f72616e646f6d,
+        k0 ^ 0x6c7967656e657261,
+        k1 ^ 0x7465646279746573,
+    };
+    const uint8_t *end = p + (size & ~(size_t) 7);
+    for (; p != end; p += 8) {
+        uint64_t m = read64(p);
+        v[3] ^= m;
+        sip_round(v);
+        sip_round(v);
+        v[0] ^= m;
+    }
+    uint64_t last = (uint64_t) size << 56;
+    size_t i;
+    for (i = 0; i < (size & 7); i++)
+        last |= (uint64_t) p[i] << (8 * i);
+    v[3] ^= last;
+    sip_round(v);
+    sip_round(v);
+    v[0] ^= last;
+    v[2] ^= 0xff;
+    sip_round(v);
+    sip_round(v);
+    sip_round(v);
+    sip_round(v);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+uint64_t hash_string_keyed(const char *s, const uint8_t key[16])
+{
+    return hash_blob_keyed(s, strlen(s), key);
+}
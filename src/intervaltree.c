@@ -0,0 +1,253 @@
+#include "intervaltree.h"
+
+#include "avltree.h"
+#include "avltree_imp.h"
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+struct interval_tree {
+    int (*cmp)(const void *, const void *, void *);
+    void *obj;
+    avl_tree_t *intervals; /* of interval_elem_t, ordered by low */
+};
+
+struct interval_elem {
+    const void *low, *high, *value;
+    const void *max_high; /* the greatest high endpoint in the subtree */
+    avl_elem_t *node;
+};
+
+static int compare_points(interval_tree_t *tree, const void *point1,
+                          const void *point2)
+{
+    return tree->cmp(point1, point2, tree->obj);
+}
+
+/* Order the intervals by their endpoints and tell equal intervals apart
+ * by their addresses. */
+static int compare_intervals(const void *key1, const void *key2, void *obj)
+{
+    const interval_elem_t *e1 = key1, *e2 = key2;
+    int cmp = compare_points(obj, e1->low, e2->low);
+    if (cmp == 0)
+        cmp = compare_points(obj, e1->high, e2->high);
+    if (cmp == 0)
+        cmp = e1 < e2 ? -1 : e1 > e2;
+    return cmp;
+}
+
+static int compare_highs(const void *key1, const void *key2, void *obj)
+{
+    const interval_elem_t *e1 = key1, *e2 = key2;
+    int cmp = compare_points(obj, e1->high, e2->high);
+    if (cmp == 0)
+        cmp = e1 < e2 ? -1 : e1 > e2;
+    return cmp;
+}
+
+static interval_elem_t *interval_of(avl_elem_t *node)
+{
+    return (interval_elem_t *) avl_elem_get_value(node);
+}
+
+static void update_max_high(avl_elem_t *node, void *obj)
+{
+    interval_elem_t *element = interval_of(node);
+    element->max_high = element->high;
+    avl_elem_t *children[] = { node->left, node->right };
+    int i;
+    for (i = 0; i < 2; i++)
+        if (children[i]) {
+            const void *max_high = interval_of(children[i])->max_high;
+            if (compare_points(obj, max_high, element->max_high) > 0)
+                element->max_high = max_high;
+        }
+}
+
+interval_tree_t *make_interval_tree_2(int (*cmp)(const void *, const void *,
+                                                 void *),
+                                      void *obj)
+{
+    interval_tree_t *tree = fsalloc(sizeof *tree);
+    tree->cmp = cmp;
+    tree->obj = obj;
+    tree->intervals = make_avl_tree_2(compare_intervals, tree);
+    tree->intervals->augment = update_max_high;
+    return tree;
+}
+
+interval_tree_t *make_interval_tree(int (*cmp)(const void *, const void *))
+{
+    return make_interval_tree_2((void *) cmp, NULL);
+}
+
+void destroy_interval_tree(interval_tree_t *tree)
+{
+    avl_elem_t *node;
+    for (node = avl_tree_get_first(tree->intervals); node;
+         node = avl_tree_next(node))
+        fsfree(interval_of(node));
+    destroy_avl_tree(tree->intervals);
+    fsfree(tree);
+}
+
+size_t interval_tree_size(interval_tree_t *tree)
+{
+    return avl_tree_size(tree->intervals);
+}
+
+int interval_tree_empty(interval_tree_t *tree)
+{
+    return avl_tree_empty(tree->intervals);
+}
+
+const void *interval_elem_get_low(interval_elem_t *element)
+{
+    return element->low;
+}
+
+const void *interval_elem_get_high(interval_elem_t *element)
+{
+    return element->high;
+}
+
+const void *interval_elem_get_value(interval_elem_t *element)
+{
+    return element->value;
+}
+
+interval_elem_t *interval_tree_add(interval_tree_t *tree, const void *low,
+                                   const void *high, const void *value)
+{
+    interval_elem_t *element = fsalloc(sizeof *element);
+    element->low = low;
+    element->high = high;
+    element->value = value;
+    element->max_high = high;
+    /* The intervals are told apart by their addresses, so nothing is
+     * replaced. */
+    element->node =
+        avl_tree_put_element(tree->intervals, element, element, NULL);
+    return element;
+}
+
+void interval_tree_remove(interval_tree_t *tree, interval_elem_t *element)
+{
+    avl_tree_remove(tree->intervals, element->node);
+    fsfree(element);
+}
+
+interval_elem_t *interval_tree_get_first(interval_tree_t *tree)
+{
+    avl_elem_t *node = avl_tree_get_first(tree->intervals);
+    return node ? interval_of(node) : NULL;
+}
+
+interval_elem_t *interval_tree_next(interval_elem_t *element)
+{
+    avl_elem_t *node = avl_tree_next(element->node);
+    return node ? interval_of(node) : NULL;
+}
+
+typedef struct {
+    interval_tree_t *tree;
+    const void *low, *high;
+    void (*cb)(interval_elem_t *element, void *arg);
+    void *arg;
+} overlap_query_t;
+
+static size_t find_overlaps(overlap_query_t *query, avl_elem_t *node)
+{
+    size_t count = 0;
+    for (; node; node = node->right) {
+        interval_elem_t *element = interval_of(node);
+        if (compare_points(query->tree, element->max_high, query->low) < 0)
+            break;
+        count += find_overlaps(query, node->left);
+        if (compare_points(query->tree, element->low, query->high) > 0)
+            break;
+        if (compare_points(query->tree, element->high, query->low) >= 0) {
+            query->cb(element, query->arg);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t interval_tree_overlap(interval_tree_t *tree, const void *low,
+                             const void *high,
+                             void (*cb)(interval_elem_t *element, void *arg),
+                             void *arg)
+{
+    overlap_query_t query = {
+        .tree = tree,
+        .low = low,
+        .high = high,
+        .cb = cb,
+        .arg = arg,
+    };
+    return find_overlaps(&query, tree->intervals->root);
+}
+
+size_t interval_tree_stab(interval_tree_t *tree, const void *point,
+                          void (*cb)(interval_elem_t *element, void *arg),
+                          void *arg)
+{
+    return interval_tree_overlap(tree, point, point, cb, arg);
+}
+
+static void activate(interval_elem_t *element, void *arg)
+{
+    avl_tree_put(arg, element, element);
+}
+
+/* Return the first interval whose low endpoint is greater than
+ * point. */
+static avl_elem_t *first_after(interval_tree_t *tree, const void *point)
+{
+    avl_elem_t *node = tree->intervals->root, *after = NULL;
+    while (node)
+        if (compare_points(tree, interval_of(node)->low, point) > 0) {
+            after = node;
+            node = node->left;
+        } else
+            node = node->right;
+    return after;
+}
+
+size_t interval_tree_stab_sorted(interval_tree_t *tree,
+                                 const void *const points[], size_t n,
+                                 void (*cb)(size_t index,
+                                            interval_elem_t *element,
+                                            void *arg),
+                                 void *arg)
+{
+    if (n == 0)
+        return 0;
+    /* The intervals containing the current point, ordered by their high
+     * endpoints so the expired ones come first. */
+    avl_tree_t *active = make_avl_tree_2(compare_highs, tree);
+    interval_tree_stab(tree, points[0], activate, active);
+    avl_elem_t *next = first_after(tree, points[0]);
+    size_t count = 0, i;
+    for (i = 0; i < n; i++) {
+        for (; next; next = avl_tree_next(next)) {
+            interval_elem_t *element = interval_of(next);
+            if (compare_points(tree, element->low, points[i]) > 0)
+                break;
+            if (compare_points(tree, element->high, points[i]) >= 0)
+                activate(element, active);
+        }
+        avl_elem_t *first;
+        while ((first = avl_tree_get_first(active)) &&
+               compare_points(tree, interval_of(first)->high, points[i]) < 0)
+            avl_tree_remove(active, first);
+        avl_elem_t *node;
+        for (node = first; node; node = avl_tree_next(node)) {
+            cb(i, interval_of(node), arg);
+            count++;
+        }
+    }
+    destroy_avl_tree(active);
+    return count;
+}
@@ -0,0 +1,204 @@
+#include "intmap.h"
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+enum {
+    MIN_CAPACITY = 16,
+};
+
+/* The key 0 marks an empty slot. The element with the key 0, if any,
+ * is kept aside. The slots use linear probing with backward-shift
+ * deletion so there are no tombstones. */
+struct intmap {
+    size_t capacity, size;
+    unsigned shift; /* 64 - log2(capacity) */
+    uint64_t *keys;
+    const void **values;
+    bool has_zero;
+    const void *zero_value;
+};
+
+static size_t max_load(size_t capacity)
+{
+    return capacity / 4 * 3;
+}
+
+/* Fibonacci hashing: the top bits of the product are well mixed. */
+static inline size_t home(intmap_t *map, uint64_t key)
+{
+    return (key * 0x9e3779b97f4a7c15) >> map->shift;
+}
+
+static void allocate(intmap_t *map, size_t capacity)
+{
+    map->capacity = capacity;
+    map->shift = 64;
+    while (capacity >>= 1)
+        map->shift--;
+    map->keys = fscalloc(map->capacity, sizeof *map->keys);
+    map->values = fsalloc(map->capacity * sizeof *map->values);
+}
+
+intmap_t *make_intmap(size_t capacity)
+{
+    intmap_t *map = fsalloc(sizeof *map);
+    size_t n = MIN_CAPACITY;
+    while (max_load(n) < capacity)
+        n *= 2;
+    allocate(map, n);
+    map->size = 0;
+    map->has_zero = false;
+    map->zero_value = NULL;
+    return map;
+}
+
+void destroy_intmap(intmap_t *map)
+{
+    fsfree(map->keys);
+    fsfree(map->values);
+    fsfree(map);
+}
+
+size_t intmap_size(intmap_t *map)
+{
+    return map->size;
+}
+
+int intmap_empty(intmap_t *map)
+{
+    return map->size == 0;
+}
+
+/* Return the slot of key or the empty slot where it belongs. */
+static inline size_t find(intmap_t *map, uint64_t key)
+{
+    size_t mask = map->capacity - 1;
+    size_t i = home(map, key);
+    while (map->keys[i] != key && map->keys[i] != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+bool intmap_get(intmap_t *map, uint64_t key, const void **pvalue)
+{
+    if (key == 0) {
+        if (map->has_zero && pvalue)
+            *pvalue = map->zero_value;
+        return map->has_zero;
+    }
+    size_t i = find(map, key);
+    if (map->keys[i] == 0)
+        return false;
+    if (pvalue)
+        *pvalue = map->values[i];
+    return true;
+}
+
+static void grow(intmap_t *map)
+{
+    uint64_t *keys = map->keys;
+    const void **values = map->values;
+    size_t capacity = map->capacity;
+    allocate(map, 2 * capacity);
+    size_t i;
+    for (i = 0; i < capacity; i++)
+        if (keys[i] != 0) {
+            size_t slot = find(map, keys[i]);
+            map->keys[slot] = keys[i];
+            map->values[slot] = values[i];
+        }
+    fsfree(keys);
+    fsfree(values);
+}
+
+bool intmap_put(intmap_t *map, uint64_t key, const void *value,
+                const void **pold_value)
+{
+    if (key == 0) {
+        bool had_zero = map->has_zero;
+        if (had_zero && pold_value)
+            *pold_value = map->zero_value;
+        else if (!had_zero)
+            map->size++;
+        map->has_zero = true;
+        map->zero_value = value;
+        return had_zero;
+    }
+    size_t i = find(map, key);
+    if (map->keys[i] != 0) {
+        if (pold_value)
+            *pold_value = map->values[i];
+        map->values[i] = value;
+        return true;
+    }
+    if (map->size + 1 > max_load(map->capacity)) {
+        grow(map);
+        i = find(map, key);
+    }
+    map->keys[i] = key;
+    map->values[i] = value;
+    map->size++;
+    return false;
+}
+
+bool intmap_pop(intmap_t *map, uint64_t key, const void **pvalue)
+{
+    if (key == 0) {
+        if (!map->has_zero)
+            return false;
+        if (pvalue)
+            *pvalue = map->zero_value;
+        map->has_zero = false;
+        map->size--;
+        return true;
+    }
+    size_t i = find(map, key);
+    if (map->keys[i] == 0)
+        return false;
+    if (pvalue)
+        *pvalue = map->values[i];
+    size_t mask = map->capacity - 1;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (map->keys[j] == 0)
+            break;
+        size_t k = home(map, map->keys[j]);
+        if (i <= j ? i < k && k <= j : i < k || k <= j)
+            continue;
+        map->keys[i] = map->keys[j];
+        map->values[i] = map->values[j];
+        i = j;
+    }
+    map->keys[i] = 0;
+    map->size--;
+    return true;
+}
+
+/* Cursor 0 stands for the key 0 and cursor i + 1 for slot i. */
+bool intmap_next(intmap_t *map, size_t *cursor, uint64_t *pkey,
+                 const void **pvalue)
+{
+    if (*cursor == 0) {
+        *cursor = 1;
+        if (map->has_zero) {
+            if (pkey)
+                *pkey = 0;
+            if (pvalue)
+                *pvalue = map->zero_value;
+            return true;
+        }
+    }
+    while (*cursor <= map->capacity) {
+        size_t i = (*cursor)++ - 1;
+        if (map->keys[i] != 0) {
+            if (pkey)
+                *pkey = map->keys[i];
+            if (pvalue)
+                *pvalue = map->values[i];
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,162 @@
+#include "keyed_priority_queue.h"
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+/* The heap is 4-ary: the keys of the children of a slot take up 64
+ * bytes, so finding the least of them touches one or two cache lines,
+ * and the heap is half as deep as a binary one. */
+enum {
+    ARITY = 4,
+};
+
+typedef struct {
+    uint64_t key;
+    const void *value;
+} entry_t;
+
+struct kpriorq {
+    void (*reloc)(const void *elem, void *loc, void *obj);
+    void *obj;
+    entry_t *storage;
+    size_t size;
+    size_t capacity;
+};
+
+static void dummy_reloc(const void *value, void *loc, void *obj) {}
+
+kpriorq_t *make_keyed_priority_queue_2(
+    void (*reloc)(const void *elem, void *loc, void *obj), void *obj)
+{
+    kpriorq_t *kprq = fsalloc(sizeof *kprq);
+    kprq->reloc = reloc ? reloc : dummy_reloc;
+    kprq->obj = obj;
+    kprq->storage = NULL;
+    kprq->size = 0;
+    kprq->capacity = 0;
+    return kprq;
+}
+
+kpriorq_t *make_keyed_priority_queue(void (*reloc)(const void *, void *loc))
+{
+    return make_keyed_priority_queue_2((void *) reloc, NULL);
+}
+
+void destroy_keyed_priority_queue(kpriorq_t *kprq)
+{
+    fsfree(kprq->storage);
+    fsfree(kprq);
+}
+
+static void assign(kpriorq_t *kprq, size_t slot, entry_t entry)
+{
+    kprq->storage[slot] = entry;
+    kprq->reloc(entry.value, (void *) (intptr_t) slot, kprq->obj);
+}
+
+static size_t raise(kpriorq_t *kprq, size_t slot, uint64_t key)
+{
+    while (slot) {
+        size_t parent = (slot - 1) / ARITY;
+        if (key >= kprq->storage[parent].key)
+            break;
+        assign(kprq, slot, kprq->storage[parent]);
+        slot = parent;
+    }
+    return slot;
+}
+
+static void lower(kpriorq_t *kprq, size_t slot, entry_t entry)
+{
+    for (;;) {
+        size_t first = slot * ARITY + 1;
+        if (first >= kprq->size)
+            break;
+        size_t end = first + ARITY;
+        if (end > kprq->size)
+            end = kprq->size;
+        size_t branch = first, child;
+        for (child = first + 1; child < end; child++)
+            if (kprq->storage[child].key < kprq->storage[branch].key)
+                branch = child;
+        if (entry.key <= kprq->storage[branch].key)
+            break;
+        assign(kprq, slot, kprq->storage[branch]);
+        slot = branch;
+    }
+    assign(kprq, slot, entry);
+}
+
+void kpriorq_enqueue(kpriorq_t *kprq, uint64_t key, const void *value)
+{
+    if (kprq->size == kprq->capacity) {
+        kprq->capacity = kprq->capacity ? 2 * kprq->capacity : 16;
+        kprq->storage =
+            fsrealloc(kprq->storage, kprq->capacity * sizeof *kprq->storage);
+    }
+    entry_t entry = { key, value };
+    size_t slot = kprq->size++;
+    assign(kprq, raise(kprq, slot, key), entry);
+}
+
+bool kpriorq_empty(kpriorq_t *kprq)
+{
+    return kprq->size == 0;
+}
+
+size_t kpriorq_size(kpriorq_t *kprq)
+{
+    return kprq->size;
+}
+
+static const void *get(entry_t *entry, uint64_t *pkey)
+{
+    if (pkey)
+        *pkey = entry->key;
+    return entry->value;
+}
+
+const void *kpriorq_dequeue(kpriorq_t *kprq, uint64_t *pkey)
+{
+    if (kpriorq_empty(kprq))
+        return NULL;
+    entry_t first = kprq->storage[0];
+    if (--kprq->size)
+        lower(kprq, 0, kprq->storage[kprq->size]);
+    return get(&first, pkey);
+}
+
+const void *kpriorq_peek(kpriorq_t *kprq, uint64_t *pkey)
+{
+    if (kpriorq_empty(kprq))
+        return NULL;
+    return get(&kprq->storage[0], pkey);
+}
+
+const void *kpriorq_pop(kpriorq_t *kprq, uint64_t *pkey)
+{
+    if (kpriorq_empty(kprq))
+        return NULL;
+    return get(&kprq->storage[--kprq->size], pkey);
+}
+
+const void *kpriorq_remove(kpriorq_t *kprq, void *loc)
+{
+    size_t slot = (intptr_t) loc;
+    const void *value = kprq->storage[slot].value;
+    entry_t other = kprq->storage[--kprq->size];
+    if (slot < kprq->size)
+        lower(kprq, raise(kprq, slot, other.key), other);
+    return value;
+}
+
+void kpriorq_update(kpriorq_t *kprq, void *loc, uint64_t key)
+{
+    size_t slot = (intptr_t) loc;
+    entry_t entry = { key, kprq->storage[slot].value };
+    size_t raised = raise(kprq, slot, key);
+    if (raised != slot)
+        assign(kprq, raised, entry);
+    else
+        lower(kprq, slot, entry);
+}
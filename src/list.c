@@ -22,6 +22,23 @@ void destroy_list(list_t *list)
     fsfree(list);
 }
 
+bool destroy_list_incrementally(list_t *list, size_t max_elements,
+                                void (*cb)(const void *value, void *arg),
+                                void *arg)
+{
+    for (; list->first && max_elements; max_elements--) {
+        list_elem_t *element = list->first;
+        list->first = element->next;
+        if (cb)
+            cb(element->value, arg);
+        fsfree(element);
+    }
+    if (list->first)
+        return false;
+    fsfree(list);
+    return true;
+}
+
 const void *list_elem_get_value(list_elem_t *element)
 {
     return element->value;
@@ -0,0 +1,210 @@
+#include "multiqueue.h"
+
+#include <stdint.h>
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+#include "priority_queue.h"
+#include "spinlock.h"
+
+enum {
+    MIN_QUEUES = 2,
+    ARITY = 4,
+    DEQUEUE_ATTEMPTS = 8,
+    CACHE_LINE = 64,
+};
+
+/* The size is only modified under the lock but read without it. Each
+ * queue occupies a cache line of its own. */
+typedef struct {
+    priorq_t *prq;
+    size_t size;
+    spinlock_t lock;
+    char padding[CACHE_LINE - sizeof(void *) - sizeof(size_t) -
+                 sizeof(spinlock_t)];
+} queue_t;
+
+struct multiqueue {
+    int (*cmp)(const void *elem1, const void *elem2, void *obj);
+    void *obj;
+    unsigned count;
+    void *queue_memory;
+    queue_t *queues;
+};
+
+/* Every thread has a random number generator of its own so choosing a
+ * queue does not contend on shared memory. */
+static __thread uint64_t random_state;
+
+static uint64_t next_random(void)
+{
+    uint64_t state = random_state;
+    if (!state) {
+        /* Seed with the address of the thread-local state, which is
+         * unique among the live threads. */
+        state = (uintptr_t) &random_state * 0x9e3779b97f4a7c15 | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    random_state = state;
+    return state;
+}
+
+static queue_t *random_queue(multiqueue_t *mq)
+{
+    return &mq->queues[(next_random() >> 32) * mq->count >> 32];
+}
+
+multiqueue_t *make_multiqueue_2(unsigned queues,
+                                int (*cmp)(const void *elem1,
+                                           const void *elem2, void *obj),
+                                void *obj)
+{
+    multiqueue_t *mq = fsalloc(sizeof *mq);
+    mq->cmp = cmp;
+    mq->obj = obj;
+    mq->count = queues < MIN_QUEUES ? MIN_QUEUES : queues;
+    mq->queue_memory = fsalloc(mq->count * sizeof(queue_t) + CACHE_LINE - 1);
+    mq->queues = (queue_t *) (((uintptr_t) mq->queue_memory + CACHE_LINE -
+                               1) &
+                              ~(uintptr_t) (CACHE_LINE - 1));
+    unsigned i;
+    for (i = 0; i < mq->count; i++) {
+        queue_t *queue = &mq->queues[i];
+        queue->prq = make_d_ary_priority_queue(cmp, NULL, obj, ARITY);
+        queue->size = 0;
+        spinlock_init(&queue->lock);
+    }
+    return mq;
+}
+
+multiqueue_t *make_multiqueue(unsigned queues,
+                              int (*cmp)(const void *, const void *))
+{
+    return make_multiqueue_2(queues, (void *) cmp, NULL);
+}
+
+void destroy_multiqueue(multiqueue_t *mq)
+{
+    unsigned i;
+    for (i = 0; i < mq->count; i++)
+        destroy_priority_queue(mq->queues[i].prq);
+    fsfree(mq->queue_memory);
+    fsfree(mq);
+}
+
+void multiqueue_enqueue(multiqueue_t *mq, const void *value)
+{
+    queue_t *queue = random_queue(mq);
+    unsigned spins = 0;
+    while (!spinlock_try_acquire(&queue->lock)) {
+        /* As in spinlock_acquire(), yield in case the lock holders
+         * have been preempted. */
+        if (++spins == SPINLOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+        queue = random_queue(mq);
+    }
+    priorq_enqueue(queue->prq, value);
+    __atomic_store_n(&queue->size, queue->size + 1, __ATOMIC_RELAXED);
+    spinlock_release(&queue->lock);
+}
+
+static size_t queue_size(queue_t *queue)
+{
+    return __atomic_load_n(&queue->size, __ATOMIC_RELAXED);
+}
+
+size_t multiqueue_size(multiqueue_t *mq)
+{
+    size_t size = 0;
+    unsigned i;
+    for (i = 0; i < mq->count; i++)
+        size += queue_size(&mq->queues[i]);
+    return size;
+}
+
+bool multiqueue_empty(multiqueue_t *mq)
+{
+    unsigned i;
+    for (i = 0; i < mq->count; i++)
+        if (queue_size(&mq->queues[i]))
+            return false;
+    return true;
+}
+
+/* The caller holds the lock of the queue. */
+static const void *take(queue_t *queue)
+{
+    const void *value = priorq_dequeue(queue->prq);
+    if (value)
+        __atomic_store_n(&queue->size, queue->size - 1, __ATOMIC_RELAXED);
+    return value;
+}
+
+/* Return true if the first element of queue1 has a higher priority
+ * than that of queue2. The caller holds the locks of both queues. */
+static bool precedes(multiqueue_t *mq, queue_t *queue1, queue_t *queue2)
+{
+    const void *first1 = priorq_peek(queue1->prq);
+    const void *first2 = priorq_peek(queue2->prq);
+    if (!first1)
+        return false;
+    return !first2 || mq->cmp(first1, first2, mq->obj) < 0;
+}
+
+/* Take an element from the first nonempty queue, starting at a random
+ * queue. This is the fallback when the randomly chosen queues keep
+ * turning out empty or locked. */
+static const void *scan(multiqueue_t *mq)
+{
+    unsigned start = random_queue(mq) - mq->queues, i;
+    for (i = 0; i < mq->count; i++) {
+        queue_t *queue = &mq->queues[(start + i) % mq->count];
+        if (!queue_size(queue))
+            continue;
+        spinlock_acquire(&queue->lock);
+        const void *value = take(queue);
+        spinlock_release(&queue->lock);
+        if (value)
+            return value;
+    }
+    return NULL;
+}
+
+const void *multiqueue_dequeue(multiqueue_t *mq)
+{
+    int attempt;
+    for (attempt = 0; attempt < DEQUEUE_ATTEMPTS; attempt++) {
+        queue_t *queue1 = random_queue(mq);
+        queue_t *queue2 = random_queue(mq);
+        if (queue1 == queue2 || !queue_size(queue2))
+            queue2 = NULL;
+        if (!queue_size(queue1)) {
+            if (!queue2)
+                continue;
+            queue1 = queue2;
+            queue2 = NULL;
+        }
+        /* Locks are only tried so two dequeuers cannot deadlock. */
+        if (!spinlock_try_acquire(&queue1->lock))
+            continue;
+        if (queue2 && !spinlock_try_acquire(&queue2->lock)) {
+            spinlock_release(&queue1->lock);
+            continue;
+        }
+        const void *value;
+        if (queue2 && precedes(mq, queue2, queue1))
+            value = take(queue2);
+        else
+            value = take(queue1);
+        if (queue2)
+            spinlock_release(&queue2->lock);
+        spinlock_release(&queue1->lock);
+        if (value)
+            return value;
+    }
+    return scan(mq);
+}
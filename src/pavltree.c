@@ -0,0 +1,302 @@
+#include "pavltree.h"
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+typedef struct pavl_node pavl_node_t;
+
+/* A node is referred to by its parent nodes and by the trees whose
+ * root it is. A node with a single reference belongs to its referrer
+ * alone if the referrer does, so it can be modified in place. */
+struct pavl_node {
+    unsigned refs;
+    int height;
+    const void *key, *value;
+    pavl_node_t *left, *right;
+};
+
+struct pavl_tree {
+    int (*cmp)(const void *, const void *, void *);
+    void *obj;
+    pavl_node_t *root;
+    size_t size;
+};
+
+pavl_tree_t *make_pavl_tree_2(int (*cmp)(const void *, const void *, void *),
+                              void *obj)
+{
+    pavl_tree_t *tree = fsalloc(sizeof *tree);
+    tree->cmp = cmp;
+    tree->obj = obj;
+    tree->root = NULL;
+    tree->size = 0;
+    return tree;
+}
+
+pavl_tree_t *make_pavl_tree(int (*cmp)(const void *, const void *))
+{
+    return make_pavl_tree_2((void *) cmp, NULL);
+}
+
+static pavl_node_t *retain(pavl_node_t *node)
+{
+    if (node)
+        __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+    return node;
+}
+
+static void release(pavl_node_t *node)
+{
+    while (node && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        release(node->left);
+        pavl_node_t *right = node->right;
+        fsfree(node);
+        node = right;
+    }
+}
+
+void destroy_pavl_tree(pavl_tree_t *tree)
+{
+    release(tree->root);
+    fsfree(tree);
+}
+
+pavl_tree_t *pavl_tree_snapshot(pavl_tree_t *tree)
+{
+    pavl_tree_t *snapshot = make_pavl_tree_2(tree->cmp, tree->obj);
+    snapshot->root = retain(tree->root);
+    snapshot->size = tree->size;
+    return snapshot;
+}
+
+size_t pavl_tree_size(pavl_tree_t *tree)
+{
+    return tree->size;
+}
+
+int pavl_tree_empty(pavl_tree_t *tree)
+{
+    return tree->root == NULL;
+}
+
+static pavl_node_t *get_node(pavl_tree_t *tree, const void *key)
+{
+    pavl_node_t *node = tree->root;
+    while (node) {
+        int cmp = tree->cmp(key, node->key, tree->obj);
+        if (cmp == 0)
+            return node;
+        node = cmp < 0 ? node->left : node->right;
+    }
+    return NULL;
+}
+
+bool pavl_tree_get(pavl_tree_t *tree, const void *key, const void **pvalue)
+{
+    pavl_node_t *node = get_node(tree, key);
+    if (!node)
+        return false;
+    if (pvalue)
+        *pvalue = node->value;
+    return true;
+}
+
+static pavl_node_t *make_node(const void *key, const void *value)
+{
+    pavl_node_t *node = fsalloc(sizeof *node);
+    node->refs = 1;
+    node->height = 1;
+    node->key = key;
+    node->value = value;
+    node->left = node->right = NULL;
+    return node;
+}
+
+/* Take over the caller's reference to node and return a node with the
+ * same contents that the caller may modify. */
+static pavl_node_t *own(pavl_node_t *node)
+{
+    if (__atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) == 1)
+        return node;
+    pavl_node_t *copy = make_node(node->key, node->value);
+    copy->height = node->height;
+    copy->left = retain(node->left);
+    copy->right = retain(node->right);
+    release(node);
+    return copy;
+}
+
+static int height(pavl_node_t *node)
+{
+    return node ? node->height : 0;
+}
+
+static void update_height(pavl_node_t *node)
+{
+    int left = height(node->left), right = height(node->right);
+    node->height = 1 + (left > right ? left : right);
+}
+
+/* The rotations expect node to be owned and own the child they
+ * lift. */
+static pavl_node_t *rotate_right(pavl_node_t *node)
+{
+    pavl_node_t *top = own(node->left);
+    node->left = top->right;
+    top->right = node;
+    update_height(node);
+    update_height(top);
+    return top;
+}
+
+static pavl_node_t *rotate_left(pavl_node_t *node)
+{
+    pavl_node_t *top = own(node->right);
+    node->right = top->left;
+    top->left = node;
+    update_height(node);
+    update_height(top);
+    return top;
+}
+
+static pavl_node_t *rebalance(pavl_node_t *node)
+{
+    int balance = height(node->right) - height(node->left);
+    if (balance < -1) {
+        if (height(node->left->left) < height(node->left->right))
+            node->left = rotate_left(own(node->left));
+        return rotate_right(node);
+    }
+    if (balance > 1) {
+        if (height(node->right->right) < height(node->right->left))
+            node->right = rotate_right(own(node->right));
+        return rotate_left(node);
+    }
+    update_height(node);
+    return node;
+}
+
+typedef struct {
+    const void *key, *value;
+    bool found;
+} pavl_result_t;
+
+/* The insertion and removal functions take over the caller's reference
+ * to the subtree and return a reference to the updated subtree. */
+static pavl_node_t *insert(pavl_tree_t *tree, pavl_node_t *node,
+                           const void *key, const void *value,
+                           pavl_result_t *result)
+{
+    if (!node)
+        return make_node(key, value);
+    int cmp = tree->cmp(key, node->key, tree->obj);
+    node = own(node);
+    if (cmp == 0) {
+        result->key = node->key;
+        result->value = node->value;
+        result->found = true;
+        node->key = key;
+        node->value = value;
+        return node;
+    }
+    if (cmp < 0)
+        node->left = insert(tree, node->left, key, value, result);
+    else
+        node->right = insert(tree, node->right, key, value, result);
+    return rebalance(node);
+}
+
+bool pavl_tree_put(pavl_tree_t *tree, const void *key, const void *value,
+                   const void **pold_key, const void **pold_value)
+{
+    pavl_result_t result = { .found = false };
+    tree->root = insert(tree, tree->root, key, value, &result);
+    if (!result.found) {
+        tree->size++;
+        return false;
+    }
+    if (pold_key)
+        *pold_key = result.key;
+    if (pold_value)
+        *pold_value = result.value;
+    return true;
+}
+
+/* Free an owned node but not its children. */
+static pavl_node_t *unlink_node(pavl_node_t *node, pavl_node_t *child)
+{
+    node->left = node->right = NULL;
+    release(node);
+    return child;
+}
+
+static pavl_node_t *remove_first(pavl_node_t *node, pavl_result_t *result)
+{
+    node = own(node);
+    if (!node->left) {
+        result->key = node->key;
+        result->value = node->value;
+        return unlink_node(node, node->right);
+    }
+    node->left = remove_first(node->left, result);
+    return rebalance(node);
+}
+
+/* The key must be in the subtree. */
+static pavl_node_t *remove_key(pavl_tree_t *tree, pavl_node_t *node,
+                               const void *key, pavl_result_t *result)
+{
+    int cmp = tree->cmp(key, node->key, tree->obj);
+    node = own(node);
+    if (cmp < 0)
+        node->left = remove_key(tree, node->left, key, result);
+    else if (cmp > 0)
+        node->right = remove_key(tree, node->right, key, result);
+    else {
+        result->key = node->key;
+        result->value = node->value;
+        if (!node->left)
+            return unlink_node(node, node->right);
+        if (!node->right)
+            return unlink_node(node, node->left);
+        pavl_result_t successor;
+        node->right = remove_first(node->right, &successor);
+        node->key = successor.key;
+        node->value = successor.value;
+    }
+    return rebalance(node);
+}
+
+bool pavl_tree_pop(pavl_tree_t *tree, const void *key, const void **pkey,
+                   const void **pvalue)
+{
+    /* Look before copying any nodes. */
+    if (!get_node(tree, key))
+        return false;
+    pavl_result_t result;
+    tree->root = remove_key(tree, tree->root, key, &result);
+    tree->size--;
+    if (pkey)
+        *pkey = result.key;
+    if (pvalue)
+        *pvalue = result.value;
+    return true;
+}
+
+static bool visit(pavl_node_t *node,
+                  bool (*cb)(const void *, const void *, void *), void *arg)
+{
+    for (; node; node = node->right) {
+        if (!visit(node->left, cb, arg) || !cb(node->key, node->value, arg))
+            return false;
+    }
+    return true;
+}
+
+bool pavl_tree_foreach(pavl_tree_t *tree,
+                       bool (*cb)(const void *key, const void *value,
+                                  void *arg),
+                       void *arg)
+{
+    return visit(tree->root, cb, arg);
+}
@@ -0,0 +1,464 @@
+#include "phash.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytearray.h"
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+/*
+ * The image consists of a header, a displacement per bucket, a record
+ * offset per slot and the records. Every key hashes to a bucket, and
+ * the displacement of the bucket selects the slot of the key (the
+ * "hash and displace" scheme). A record holds the key size, the value
+ * size, the value and the key, each padded to eight bytes.
+ */
+
+enum {
+    BUCKET_LOAD = 4, /* average keys per bucket */
+    MAX_SEEDS = 32,
+};
+
+static const char MAGIC[8] = "FSPHASH\1";
+
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    uint64_t seed;
+    uint64_t count;
+    uint64_t bucket_count;
+    uint64_t displacements, slots, records; /* file offsets */
+} phash_header_t;
+
+typedef struct {
+    uint64_t key_size, value_size;
+} phash_record_t;
+
+typedef struct {
+    uint64_t hash;
+    size_t offset; /* of the record */
+} phash_entry_t;
+
+struct phash_builder {
+    byte_array_t *records;
+    phash_entry_t *entries;
+    size_t count, capacity;
+};
+
+struct phash {
+    void *image;
+    size_t size;
+    const phash_header_t *header;
+    const uint32_t *displacements;
+    const uint64_t *slots;
+    const uint8_t *records;
+    size_t records_size;
+};
+
+static uint64_t scramble(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static size_t padded(size_t size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+static size_t get_bucket(uint64_t hash, uint64_t bucket_count)
+{
+    return (hash >> 32) % bucket_count;
+}
+
+static size_t get_slot(uint64_t hash, uint32_t displacement, uint64_t count)
+{
+    return scramble(hash ^ displacement * 0x9e3779b97f4a7c15) % count;
+}
+
+phash_builder_t *make_phash_builder(void)
+{
+    phash_builder_t *builder = fsalloc(sizeof *builder);
+    builder->records = make_byte_array(SIZE_MAX);
+    builder->count = 0;
+    builder->capacity = 16;
+    builder->entries =
+        fsalloc(builder->capacity * sizeof builder->entries[0]);
+    return builder;
+}
+
+void destroy_phash_builder(phash_builder_t *builder)
+{
+    destroy_byte_array(builder->records);
+    fsfree(builder->entries);
+    fsfree(builder);
+}
+
+void phash_builder_add(phash_builder_t *builder, const void *key,
+                       size_t key_size, const void *value, size_t value_size)
+{
+    static const uint8_t zeros[8];
+    if (builder->count == builder->capacity) {
+        builder->capacity *= 2;
+        builder->entries =
+            fsrealloc(builder->entries,
+                      builder->capacity * sizeof builder->entries[0]);
+    }
+    phash_entry_t *entry = &builder->entries[builder->count++];
+    entry->offset = byte_array_size(builder->records);
+    phash_record_t record = {
+        .key_size = key_size,
+        .value_size = value_size,
+    };
+    byte_array_append(builder->records, &record, sizeof record);
+    byte_array_append(builder->records, value, value_size);
+    byte_array_append(builder->records, zeros, padded(value_size) - value_size);
+    byte_array_append(builder->records, key, key_size);
+    byte_array_append(builder->records, zeros, padded(key_size) - key_size);
+}
+
+void phash_builder_add_hash_table(phash_builder_t *builder,
+                                  hash_table_t *table,
+                                  void (*encode)(void *obj,
+                                                 phash_builder_t *builder,
+                                                 const void *key,
+                                                 const void *value),
+                                  void *obj)
+{
+    hash_elem_t *element;
+    for (element = hash_table_get_any(table); element;
+         element = hash_table_get_other(element))
+        encode(obj, builder, hash_elem_get_key(element),
+               hash_elem_get_value(element));
+}
+
+static const phash_record_t *get_record(const uint8_t *records, size_t offset)
+{
+    return (const phash_record_t *) (records + offset);
+}
+
+static const void *get_key(const phash_record_t *record)
+{
+    return (const uint8_t *) (record + 1) + padded(record->value_size);
+}
+
+static bool same_key(const phash_record_t *a, const phash_record_t *b)
+{
+    return a->key_size == b->key_size &&
+        memcmp(get_key(a), get_key(b), a->key_size) == 0;
+}
+
+typedef struct {
+    uint64_t seed;
+    uint64_t bucket_count;
+    uint32_t *displacements;
+    uint64_t *slots;
+} phash_layout_t;
+
+/* Return 1 if every key got a slot of its own, 0 if a different seed
+ * should be tried and -1 if there are duplicate keys. */
+static int place(phash_builder_t *builder, phash_layout_t *layout)
+{
+    size_t n = builder->count, bucket_count = layout->bucket_count;
+    const uint8_t *records = byte_array_data(builder->records);
+    size_t i, b;
+    for (i = 0; i < n; i++) {
+        phash_entry_t *entry = &builder->entries[i];
+        const phash_record_t *record = get_record(records, entry->offset);
+        entry->hash = hash_blob_seeded(get_key(record), record->key_size,
+                                       layout->seed);
+    }
+    /* Group the entries by bucket. */
+    size_t *start = fscalloc(bucket_count + 1, sizeof *start);
+    for (i = 0; i < n; i++)
+        start[get_bucket(builder->entries[i].hash, bucket_count) + 1]++;
+    size_t max_size = 0;
+    for (b = 0; b < bucket_count; b++) {
+        if (start[b + 1] > max_size)
+            max_size = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    size_t *fill = fsalloc(bucket_count * sizeof *fill);
+    memcpy(fill, start, bucket_count * sizeof *fill);
+    phash_entry_t **members = fsalloc(n * sizeof *members);
+    for (i = 0; i < n; i++) {
+        phash_entry_t *entry = &builder->entries[i];
+        members[fill[get_bucket(entry->hash, bucket_count)]++] = entry;
+    }
+    /* Place the largest buckets first while most slots are free. */
+    size_t *by_size = fscalloc(max_size + 2, sizeof *by_size);
+    for (b = 0; b < bucket_count; b++)
+        by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+    for (i = 0; i <= max_size; i++)
+        by_size[i + 1] += by_size[i];
+    size_t *order = fill;
+    for (b = 0; b < bucket_count; b++)
+        order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+    uint8_t *taken = fscalloc(n ? n : 1, 1);
+    size_t *chosen = fsalloc((max_size ? max_size : 1) * sizeof *chosen);
+    uint64_t max_tries = 64 * (uint64_t) n + 1024;
+    if (max_tries > UINT32_MAX)
+        max_tries = UINT32_MAX;
+    int result = 1;
+    size_t k;
+    for (k = 0; k < bucket_count && result == 1; k++) {
+        b = order[k];
+        size_t size = start[b + 1] - start[b];
+        phash_entry_t **bucket = members + start[b];
+        size_t j, m;
+        for (j = 0; j < size && result == 1; j++)
+            for (m = 0; m < j; m++)
+                if (bucket[j]->hash == bucket[m]->hash) {
+                    if (same_key(get_record(records, bucket[j]->offset),
+                                 get_record(records, bucket[m]->offset)))
+                        result = -1;
+                    else
+                        result = 0;
+                    break;
+                }
+        if (result != 1 || !size) {
+            layout->displacements[b] = 0;
+            continue;
+        }
+        uint64_t d;
+        for (d = 0; d < max_tries; d++) {
+            for (j = 0; j < size; j++) {
+                chosen[j] = get_slot(bucket[j]->hash, d, n);
+                if (taken[chosen[j]])
+                    break;
+                for (m = 0; m < j && chosen[m] != chosen[j]; m++)
+                    ;
+                if (m < j)
+                    break;
+            }
+            if (j == size)
+                break;
+        }
+        if (d == max_tries) {
+            result = 0;
+            break;
+        }
+        layout->displacements[b] = d;
+        for (j = 0; j < size; j++) {
+            taken[chosen[j]] = 1;
+            layout->slots[chosen[j]] = bucket[j]->offset;
+        }
+    }
+    fsfree(chosen);
+    fsfree(taken);
+    fsfree(by_size);
+    fsfree(members);
+    fsfree(fill);
+    fsfree(start);
+    return result;
+}
+
+static bool write_image(FILE *f, phash_builder_t *builder,
+                        phash_layout_t *layout)
+{
+    static const uint8_t zeros[8];
+    size_t displacements_size =
+        layout->bucket_count * sizeof layout->displacements[0];
+    phash_header_t header;
+    memcpy(header.magic, MAGIC, sizeof header.magic);
+    header.seed = layout->seed;
+    header.count = builder->count;
+    header.bucket_count = layout->bucket_count;
+    header.displacements = sizeof header;
+    header.slots = header.displacements + padded(displacements_size);
+    header.records =
+        header.slots + builder->count * sizeof layout->slots[0];
+    header.size = header.records + byte_array_size(builder->records);
+    return fwrite(&header, sizeof header, 1, f) == 1 &&
+        fwrite(layout->displacements, 1, displacements_size, f) ==
+        displacements_size &&
+        fwrite(zeros, 1, padded(displacements_size) - displacements_size,
+               f) == padded(displacements_size) - displacements_size &&
+        fwrite(layout->slots, sizeof layout->slots[0], builder->count, f) ==
+        builder->count &&
+        fwrite(byte_array_data(builder->records), 1,
+               byte_array_size(builder->records),
+               f) == byte_array_size(builder->records);
+}
+
+/* Write the image into a temporary file in the directory of path and
+ * rename it over path so processes that have the old image mapped
+ * keep seeing it intact. */
+static bool write_file(phash_builder_t *builder, phash_layout_t *layout,
+                       const char *path)
+{
+    static const char suffix[] = ".XXXXXX";
+    size_t length = strlen(path);
+    char *temp = fsalloc(length + sizeof suffix);
+    memcpy(temp, path, length);
+    memcpy(temp + length, suffix, sizeof suffix);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        fsfree(temp);
+        return false;
+    }
+    struct stat st;
+    mode_t mode = stat(path, &st) == 0 ? st.st_mode & 07777 : 0644;
+    FILE *f = fdopen(fd, "wb");
+    if (!f) {
+        int err = errno;
+        close(fd);
+        unlink(temp);
+        fsfree(temp);
+        errno = err;
+        return false;
+    }
+    bool ok = fchmod(fd, mode) == 0 && write_image(f, builder, layout) &&
+        fflush(f) == 0 && fsync(fd) == 0;
+    int err = errno;
+    if (fclose(f) == EOF && ok) {
+        ok = false;
+        err = errno;
+    }
+    if (ok && rename(temp, path) < 0) {
+        ok = false;
+        err = errno;
+    }
+    if (!ok)
+        unlink(temp);
+    fsfree(temp);
+    errno = err;
+    return ok;
+}
+
+bool phash_builder_write(phash_builder_t *builder, const char *path)
+{
+    phash_layout_t layout;
+    layout.bucket_count = builder->count / BUCKET_LOAD + 1;
+    layout.displacements =
+        fsalloc(layout.bucket_count * sizeof layout.displacements[0]);
+    layout.slots = fsalloc((builder->count ? builder->count : 1) *
+                           sizeof layout.slots[0]);
+    int result = 0;
+    for (layout.seed = 0; layout.seed < MAX_SEEDS && result == 0;
+         layout.seed++) {
+        result = place(builder, &layout);
+        if (result == 1)
+            break;
+    }
+    bool ok = false;
+    if (result == 1)
+        ok = write_file(builder, &layout, path);
+    else if (result < 0)
+        errno = EEXIST;
+    else
+        errno = EAGAIN;
+    fsfree(layout.displacements);
+    fsfree(layout.slots);
+    return ok;
+}
+
+static bool valid_header(const phash_header_t *header, size_t size)
+{
+    if (size < sizeof *header ||
+        memcmp(header->magic, MAGIC, sizeof header->magic) != 0 ||
+        header->size != size || header->bucket_count == 0 ||
+        header->displacements != sizeof *header ||
+        header->bucket_count > size / sizeof(uint32_t) ||
+        header->count > size / sizeof(uint64_t))
+        return false;
+    uint64_t slots = header->displacements +
+        padded(header->bucket_count * sizeof(uint32_t));
+    uint64_t records = slots + header->count * sizeof(uint64_t);
+    return header->slots == slots && header->records == records &&
+        records <= size;
+}
+
+phash_t *open_phash(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if (st.st_size < (off_t) sizeof(phash_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void *image = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (image == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+    const phash_header_t *header = image;
+    if (!valid_header(header, size)) {
+        munmap(image, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    phash_t *phash = fsalloc(sizeof *phash);
+    phash->image = image;
+    phash->size = size;
+    phash->header = header;
+    phash->displacements =
+        (const uint32_t *) ((const uint8_t *) image + header->displacements);
+    phash->slots = (const uint64_t *) ((const uint8_t *) image + header->slots);
+    phash->records = (const uint8_t *) image + header->records;
+    phash->records_size = size - header->records;
+    return phash;
+}
+
+void close_phash(phash_t *phash)
+{
+    munmap(phash->image, phash->size);
+    fsfree(phash);
+}
+
+size_t phash_size(phash_t *phash)
+{
+    return phash->header->count;
+}
+
+bool phash_get(phash_t *phash, const void *key, size_t key_size,
+               const void **pvalue, size_t *pvalue_size)
+{
+    const phash_header_t *header = phash->header;
+    if (header->count == 0)
+        return false;
+    uint64_t hash = hash_blob_seeded(key, key_size, header->seed);
+    uint32_t displacement =
+        phash->displacements[get_bucket(hash, header->bucket_count)];
+    uint64_t offset = phash->slots[get_slot(hash, displacement, header->count)];
+    /* Guard against corrupt images. */
+    size_t room = phash->records_size;
+    if (offset % 8 != 0 || offset > room ||
+        room - offset < sizeof(phash_record_t))
+        return false;
+    const phash_record_t *record = get_record(phash->records, offset);
+    room -= offset + sizeof *record;
+    if (record->key_size != key_size || record->value_size > room ||
+        padded(record->value_size) > room ||
+        room - padded(record->value_size) < key_size)
+        return false;
+    if (memcmp(get_key(record), key, key_size) != 0)
+        return false;
+    if (pvalue)
+        *pvalue = record + 1;
+    if (pvalue_size)
+        *pvalue_size = record->value_size;
+    return true;
+}
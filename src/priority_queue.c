@@ -10,27 +10,46 @@ struct priorq {
     int (*cmp)(const void *elem1, const void *elem2, void *obj);
     void (*reloc)(const void *elem, void *loc, void *obj);
     void *obj;
+    size_t arity;
     const void **storage;
     size_t capacity;
     size_t max_capacity;
 };
 
+enum {
+    MIN_ARITY = 2,
+    MAX_ARITY = 64,
+};
+
 static void dummy_reloc(const void *value, void *loc, void *obj) {}
 
-priorq_t *make_priority_queue_2(
+priorq_t *make_d_ary_priority_queue(
     int (*cmp)(const void *elem1, const void *elem2, void *obj),
-    void (*reloc)(const void *elem, void *loc, void *obj), void *obj)
+    void (*reloc)(const void *elem, void *loc, void *obj), void *obj,
+    size_t arity)
 {
     priorq_t *prq = fsalloc(sizeof *prq);
     prq->cmp = cmp;
     prq->obj = obj;
     prq->reloc = reloc ? reloc : dummy_reloc;
+    if (arity < MIN_ARITY)
+        arity = MIN_ARITY;
+    else if (arity > MAX_ARITY)
+        arity = MAX_ARITY;
+    prq->arity = arity;
     prq->storage = NULL;
     prq->capacity = 0;
     prq->max_capacity = 0;
     return prq;
 }
 
+priorq_t *make_priority_queue_2(
+    int (*cmp)(const void *elem1, const void *elem2, void *obj),
+    void (*reloc)(const void *elem, void *loc, void *obj), void *obj)
+{
+    return make_d_ary_priority_queue(cmp, reloc, obj, 2);
+}
+
 priorq_t *make_priority_queue(int (*cmp)(const void *, const void *),
                               void (*reloc)(const void *, void *loc))
 {
@@ -53,7 +72,7 @@ static size_t raise(priorq_t *prq, size_t slot, const void *value)
 {
     void *obj = prq->obj;
     while (slot) {
-        size_t parent = (slot - 1) / 2;
+        size_t parent = (slot - 1) / prq->arity;
         if (prq->cmp(value, prq->storage[parent], obj) >= 0)
             break;
         assign(prq, slot, prq->storage[parent]);
@@ -62,6 +81,15 @@ static size_t raise(priorq_t *prq, size_t slot, const void *value)
     return slot;
 }
 
+void priorq_reserve(priorq_t *prq, size_t capacity)
+{
+    if (capacity <= prq->max_capacity)
+        return;
+    prq->max_capacity = capacity;
+    prq->storage =
+        fsrealloc(prq->storage, prq->max_capacity * sizeof *prq->storage);
+}
+
 void priorq_enqueue(priorq_t *prq, const void *value)
 {
     if (prq->capacity == prq->max_capacity) {
@@ -73,9 +101,7 @@ void priorq_enqueue(priorq_t *prq, const void *value)
             }
             n <<= 1;
         }
-        prq->max_capacity = n;
-        prq->storage =
-            fsrealloc(prq->storage, prq->max_capacity * sizeof *prq->storage);
+        priorq_reserve(prq, n);
     }
     size_t slot = prq->capacity++;
     assign(prq, raise(prq, slot, value), value);
@@ -91,20 +117,23 @@ bool priorq_empty(priorq_t *prq)
     return priorq_size(prq) == 0;
 }
 
+/* The children of a slot are next to each other in the storage, so
+ * finding the highest-priority one of them touches one or two cache
+ * lines of the storage. */
 static void lower(priorq_t *prq, size_t slot, const void *value)
 {
     void *obj = prq->obj;
     for (;;) {
-        size_t left = slot * 2 + 1;
-        if (left >= prq->capacity)
+        size_t first = slot * prq->arity + 1;
+        if (first >= prq->capacity)
             break;
-        size_t branch;
-        size_t right = left + 1;
-        if (right >= prq->capacity ||
-            prq->cmp(prq->storage[left], prq->storage[right], obj) < 0)
-            branch = left;
-        else
-            branch = right;
+        size_t end = first + prq->arity;
+        if (end > prq->capacity)
+            end = prq->capacity;
+        size_t branch = first, child;
+        for (child = first + 1; child < end; child++)
+            if (prq->cmp(prq->storage[child], prq->storage[branch], obj) < 0)
+                branch = child;
         if (prq->cmp(value, prq->storage[branch], obj) <= 0)
             break;
         assign(prq, slot, prq->storage[branch]);
@@ -113,6 +142,32 @@ static void lower(priorq_t *prq, size_t slot, const void *value)
     assign(prq, slot, value);
 }
 
+void priorq_enqueue_array(priorq_t *prq, const void *const values[],
+                          size_t n)
+{
+    if (n > prq->max_capacity - prq->capacity)
+        priorq_reserve(prq, prq->capacity + n);
+    size_t i;
+    if (n < prq->capacity) {
+        /* Sifting the new elements up is cheaper than rebuilding a heap
+         * that is larger than the batch. */
+        for (i = 0; i < n; i++) {
+            size_t slot = prq->capacity++;
+            assign(prq, raise(prq, slot, values[i]), values[i]);
+        }
+        return;
+    }
+    for (i = 0; i < n; i++)
+        assign(prq, prq->capacity++, values[i]);
+    if (prq->capacity < 2)
+        return;
+    /* Floyd's method: sift down every slot that has children, from the
+     * last one to the root. */
+    size_t slot = (prq->capacity - 2) / prq->arity + 1;
+    while (slot--)
+        lower(prq, slot, prq->storage[slot]);
+}
+
 const void *priorq_dequeue(priorq_t *prq)
 {
     switch (prq->capacity) {
@@ -149,3 +204,14 @@ const void *priorq_remove(priorq_t *prq, void *loc)
     lower(prq, raise(prq, slot, other), other);
     return value;
 }
+
+void priorq_update(priorq_t *prq, void *loc)
+{
+    size_t slot = (intptr_t) loc;
+    const void *value = prq->storage[slot];
+    size_t raised = raise(prq, slot, value);
+    if (raised != slot)
+        assign(prq, raised, value);
+    else
+        lower(prq, slot, value);
+}
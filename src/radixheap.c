@@ -0,0 +1,143 @@
+#include "radixheap.h"
+
+#include <errno.h>
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+enum {
+    BUCKETS = 65,
+};
+
+typedef struct {
+    uint64_t key;
+    const void *value;
+} entry_t;
+
+typedef struct {
+    entry_t *entries;
+    size_t size, capacity;
+    size_t least; /* the index of the last entry with the least key */
+} bucket_t;
+
+/* Bucket 0 holds the elements whose key equals last, the key dequeued
+ * last. Bucket i > 0 holds the elements whose key differs from last
+ * first at bit i - 1 counting from the least significant bit. As last
+ * only grows, an element only ever moves to a lower bucket. */
+struct radix_heap {
+    uint64_t last;
+    size_t size;
+    uint64_t occupied; /* bit i - 1 is set if bucket i > 0 is nonempty */
+    bucket_t buckets[BUCKETS];
+};
+
+radix_heap_t *make_radix_heap(void)
+{
+    radix_heap_t *heap = fscalloc(1, sizeof *heap);
+    return heap;
+}
+
+void destroy_radix_heap(radix_heap_t *heap)
+{
+    int i;
+    for (i = 0; i < BUCKETS; i++)
+        fsfree(heap->buckets[i].entries);
+    fsfree(heap);
+}
+
+static unsigned bucket_of(radix_heap_t *heap, uint64_t key)
+{
+    uint64_t difference = key ^ heap->last;
+    return difference ? 64 - __builtin_clzll(difference) : 0;
+}
+
+static void add(radix_heap_t *heap, uint64_t key, const void *value)
+{
+    unsigned i = bucket_of(heap, key);
+    bucket_t *bucket = &heap->buckets[i];
+    if (bucket->size == bucket->capacity) {
+        bucket->capacity = bucket->capacity ? 2 * bucket->capacity : 16;
+        bucket->entries = fsrealloc(bucket->entries,
+                                    bucket->capacity * sizeof *bucket->entries);
+    }
+    if (bucket->size == 0 || key <= bucket->entries[bucket->least].key)
+        bucket->least = bucket->size;
+    bucket->entries[bucket->size++] = (entry_t) { key, value };
+    if (i)
+        heap->occupied |= (uint64_t) 1 << (i - 1);
+}
+
+bool radix_heap_enqueue(radix_heap_t *heap, uint64_t key, const void *value)
+{
+    if (key < heap->last) {
+        errno = EINVAL;
+        return false;
+    }
+    add(heap, key, value);
+    heap->size++;
+    return true;
+}
+
+bool radix_heap_empty(radix_heap_t *heap)
+{
+    return heap->size == 0;
+}
+
+size_t radix_heap_size(radix_heap_t *heap)
+{
+    return heap->size;
+}
+
+/* Return the bucket whose last entry is going to be dequeued next, or
+ * NULL if the heap is empty. If bucket 0 is empty, that is the first
+ * nonempty bucket, and the entry is the last one with the least key in
+ * it. */
+static bucket_t *first_bucket(radix_heap_t *heap)
+{
+    if (heap->buckets[0].size)
+        return &heap->buckets[0];
+    if (!heap->occupied)
+        return NULL;
+    return &heap->buckets[__builtin_ctzll(heap->occupied) + 1];
+}
+
+const void *radix_heap_dequeue(radix_heap_t *heap, uint64_t *pkey)
+{
+    bucket_t *bucket = first_bucket(heap);
+    if (!bucket)
+        return NULL;
+    if (bucket != &heap->buckets[0]) {
+        /* Raise last to the least key and spread the bucket over the
+         * lower buckets, keeping the order of the entries. The entry
+         * with the least key that was added last ends up last in
+         * bucket 0. */
+        unsigned i = bucket - heap->buckets;
+        heap->last = bucket->entries[bucket->least].key;
+        heap->occupied &= ~((uint64_t) 1 << (i - 1));
+        size_t size = bucket->size, j;
+        bucket->size = 0;
+        for (j = 0; j < size; j++)
+            add(heap, bucket->entries[j].key, bucket->entries[j].value);
+        bucket = &heap->buckets[0];
+    }
+    entry_t *entry = &bucket->entries[--bucket->size];
+    heap->size--;
+    if (pkey)
+        *pkey = entry->key;
+    return entry->value;
+}
+
+const void *radix_heap_peek(radix_heap_t *heap, uint64_t *pkey)
+{
+    bucket_t *bucket = first_bucket(heap);
+    if (!bucket)
+        return NULL;
+    entry_t *entry;
+    if (bucket == &heap->buckets[0])
+        entry = &bucket->entries[bucket->size - 1];
+    else
+        entry = &bucket->entries[bucket->least];
+    if (pkey)
+        *pkey = entry->key;
+    return entry->value;
+}
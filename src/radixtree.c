@@ -0,0 +1,729 @@
+#include "radixtree.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+enum {
+    NODE4,
+    NODE16,
+    NODE48,
+    NODE256,
+};
+
+enum {
+    MAX_PREFIX = 12,
+};
+
+typedef struct {
+    const void *key, *value;
+    size_t size;
+} leaf_t;
+
+/* A node at depth d consumes the key bytes [d, d + prefix_size) and
+ * branches on the byte after them. A key ending after the prefix is
+ * kept as the terminal leaf. Only the first MAX_PREFIX bytes of a
+ * prefix are stored; the rest can be found in any leaf under the node.
+ *
+ * A reference to a child is either a node_t pointer or a leaf_t pointer
+ * with the lowest bit set. */
+typedef struct {
+    uint8_t type;
+    uint16_t count; /* number of children */
+    uint8_t prefix[MAX_PREFIX];
+    size_t prefix_size;
+    leaf_t *terminal;
+} node_t;
+
+typedef struct {
+    node_t node;
+    uint8_t keys[4];
+    node_t *children[4];
+} node4_t;
+
+typedef struct {
+    node_t node;
+    uint8_t keys[16];
+    node_t *children[16];
+} node16_t;
+
+typedef struct {
+    node_t node;
+    uint8_t index[256]; /* 1 + position in children, or 0 */
+    node_t *children[48];
+} node48_t;
+
+typedef struct {
+    node_t node;
+    node_t *children[256];
+} node256_t;
+
+struct radix_tree {
+    node_t *root;
+    size_t size;
+};
+
+static bool is_leaf(node_t *ref)
+{
+    return (uintptr_t) ref & 1;
+}
+
+static leaf_t *leaf_of(node_t *ref)
+{
+    return (leaf_t *) ((uintptr_t) ref - 1);
+}
+
+static node_t *leaf_ref(leaf_t *leaf)
+{
+    return (node_t *) ((uintptr_t) leaf + 1);
+}
+
+static bool leaf_matches(leaf_t *leaf, const uint8_t *key, size_t size)
+{
+    return leaf->size == size && !memcmp(leaf->key, key, size);
+}
+
+radix_tree_t *make_radix_tree(void)
+{
+    radix_tree_t *tree = fsalloc(sizeof *tree);
+    tree->root = NULL;
+    tree->size = 0;
+    return tree;
+}
+
+static node_t *make_node(uint8_t type)
+{
+    static const size_t sizes[] = {
+        [NODE4] = sizeof(node4_t),
+        [NODE16] = sizeof(node16_t),
+        [NODE48] = sizeof(node48_t),
+        [NODE256] = sizeof(node256_t),
+    };
+    node_t *node = fscalloc(1, sizes[type]);
+    node->type = type;
+    return node;
+}
+
+/* Return the child after the one at *pcursor in byte order, or NULL.
+ * Start with *pcursor == 0. */
+static node_t *next_child(node_t *node, unsigned *pcursor)
+{
+    node48_t *n48;
+    node256_t *n256;
+    switch (node->type) {
+        case NODE4:
+            if (*pcursor < node->count)
+                return ((node4_t *) node)->children[(*pcursor)++];
+            return NULL;
+        case NODE16:
+            if (*pcursor < node->count)
+                return ((node16_t *) node)->children[(*pcursor)++];
+            return NULL;
+        case NODE48:
+            n48 = (node48_t *) node;
+            while (*pcursor < 256) {
+                uint8_t slot = n48->index[(*pcursor)++];
+                if (slot)
+                    return n48->children[slot - 1];
+            }
+            return NULL;
+        default:
+            n256 = (node256_t *) node;
+            while (*pcursor < 256) {
+                node_t *child = n256->children[(*pcursor)++];
+                if (child)
+                    return child;
+            }
+            return NULL;
+    }
+}
+
+static void destroy_subtree(node_t *ref)
+{
+    if (is_leaf(ref)) {
+        fsfree(leaf_of(ref));
+        return;
+    }
+    if (ref->terminal)
+        fsfree(ref->terminal);
+    unsigned cursor = 0;
+    node_t *child;
+    while ((child = next_child(ref, &cursor)))
+        destroy_subtree(child);
+    fsfree(ref);
+}
+
+void destroy_radix_tree(radix_tree_t *tree)
+{
+    if (tree->root)
+        destroy_subtree(tree->root);
+    fsfree(tree);
+}
+
+size_t radix_tree_size(radix_tree_t *tree)
+{
+    return tree->size;
+}
+
+int radix_tree_empty(radix_tree_t *tree)
+{
+    return tree->root == NULL;
+}
+
+static int search16(node16_t *node, uint8_t byte)
+{
+#ifdef __SSE2__
+    __m128i keys = _mm_loadu_si128((const __m128i *) node->keys);
+    __m128i hits = _mm_cmpeq_epi8(keys, _mm_set1_epi8((char) byte));
+    unsigned mask = _mm_movemask_epi8(hits) & ((1U << node->node.count) - 1);
+    return mask ? __builtin_ctz(mask) : -1;
+#else
+    int i;
+    for (i = 0; i < node->node.count; i++)
+        if (node->keys[i] == byte)
+            return i;
+    return -1;
+#endif
+}
+
+/* Return the location of the child for byte, or NULL. */
+static node_t **find_child(node_t *node, uint8_t byte)
+{
+    node4_t *n4;
+    node16_t *n16;
+    node48_t *n48;
+    node256_t *n256;
+    int i;
+    switch (node->type) {
+        case NODE4:
+            n4 = (node4_t *) node;
+            for (i = 0; i < node->count; i++)
+                if (n4->keys[i] == byte)
+                    return &n4->children[i];
+            return NULL;
+        case NODE16:
+            n16 = (node16_t *) node;
+            i = search16(n16, byte);
+            return i >= 0 ? &n16->children[i] : NULL;
+        case NODE48:
+            n48 = (node48_t *) node;
+            i = n48->index[byte];
+            return i ? &n48->children[i - 1] : NULL;
+        default:
+            n256 = (node256_t *) node;
+            return n256->children[byte] ? &n256->children[byte] : NULL;
+    }
+}
+
+static void insert_sorted(uint8_t keys[], node_t *children[], unsigned count,
+                          uint8_t byte, node_t *child)
+{
+    unsigned i = 0;
+    while (i < count && keys[i] < byte)
+        i++;
+    memmove(keys + i + 1, keys + i, count - i);
+    memmove(children + i + 1, children + i, (count - i) * sizeof *children);
+    keys[i] = byte;
+    children[i] = child;
+}
+
+/* The node must have room for the child. */
+static void insert_child(node_t *node, uint8_t byte, node_t *child)
+{
+    node4_t *n4;
+    node16_t *n16;
+    node48_t *n48;
+    unsigned slot;
+    switch (node->type) {
+        case NODE4:
+            n4 = (node4_t *) node;
+            insert_sorted(n4->keys, n4->children, node->count, byte, child);
+            break;
+        case NODE16:
+            n16 = (node16_t *) node;
+            insert_sorted(n16->keys, n16->children, node->count, byte, child);
+            break;
+        case NODE48:
+            n48 = (node48_t *) node;
+            for (slot = 0; n48->children[slot]; slot++)
+                ;
+            n48->children[slot] = child;
+            n48->index[byte] = slot + 1;
+            break;
+        default:
+            ((node256_t *) node)->children[byte] = child;
+    }
+    node->count++;
+}
+
+static void copy_header(node_t *to, node_t *from)
+{
+    to->prefix_size = from->prefix_size;
+    memcpy(to->prefix, from->prefix, MAX_PREFIX);
+    to->terminal = from->terminal;
+}
+
+/* Return the byte of the child that next_child() returned last. */
+static uint8_t byte_before(node_t *node, unsigned cursor)
+{
+    switch (node->type) {
+        case NODE4:
+            return ((node4_t *) node)->keys[cursor - 1];
+        case NODE16:
+            return ((node16_t *) node)->keys[cursor - 1];
+        default:
+            return cursor - 1;
+    }
+}
+
+/* Move the children of node to a node of the given type and free
+ * node. */
+static node_t *resize(node_t *node, uint8_t type)
+{
+    node_t *resized = make_node(type);
+    copy_header(resized, node);
+    unsigned cursor = 0;
+    node_t *child;
+    while ((child = next_child(node, &cursor)))
+        insert_child(resized, byte_before(node, cursor), child);
+    fsfree(node);
+    return resized;
+}
+
+static void add_child(node_t **pref, uint8_t byte, node_t *child)
+{
+    static const unsigned capacities[] = {
+        [NODE4] = 4,
+        [NODE16] = 16,
+        [NODE48] = 48,
+        [NODE256] = 257,
+    };
+    node_t *node = *pref;
+    if (node->count == capacities[node->type])
+        *pref = node = resize(node, node->type + 1);
+    insert_child(node, byte, child);
+}
+
+static void remove_sorted(uint8_t keys[], node_t *children[], unsigned count,
+                          uint8_t byte)
+{
+    unsigned i = 0;
+    while (keys[i] != byte)
+        i++;
+    memmove(keys + i, keys + i + 1, count - i - 1);
+    memmove(children + i, children + i + 1,
+            (count - i - 1) * sizeof *children);
+}
+
+static void remove_child(node_t *node, uint8_t byte)
+{
+    node4_t *n4;
+    node16_t *n16;
+    node48_t *n48;
+    switch (node->type) {
+        case NODE4:
+            n4 = (node4_t *) node;
+            remove_sorted(n4->keys, n4->children, node->count, byte);
+            break;
+        case NODE16:
+            n16 = (node16_t *) node;
+            remove_sorted(n16->keys, n16->children, node->count, byte);
+            break;
+        case NODE48:
+            n48 = (node48_t *) node;
+            n48->children[n48->index[byte] - 1] = NULL;
+            n48->index[byte] = 0;
+            break;
+        default:
+            ((node256_t *) node)->children[byte] = NULL;
+    }
+    node->count--;
+}
+
+static leaf_t *minimum(node_t *ref)
+{
+    while (!is_leaf(ref)) {
+        if (ref->terminal)
+            return ref->terminal;
+        unsigned cursor = 0;
+        ref = next_child(ref, &cursor);
+    }
+    return leaf_of(ref);
+}
+
+static void set_prefix(node_t *node, const uint8_t *bytes, size_t size)
+{
+    node->prefix_size = size;
+    memmove(node->prefix, bytes, size < MAX_PREFIX ? size : MAX_PREFIX);
+}
+
+/* Replace a node4 that has a single child or only a terminal leaf with
+ * the child or the leaf. A node never has fewer entries. */
+static void collapse(node_t **pref)
+{
+    node_t *node = *pref;
+    if (node->count == 0) {
+        *pref = leaf_ref(node->terminal);
+        fsfree(node);
+        return;
+    }
+    node4_t *n4 = (node4_t *) node;
+    node_t *child = n4->children[0];
+    if (!is_leaf(child)) {
+        uint8_t prefix[MAX_PREFIX];
+        size_t n = node->prefix_size < MAX_PREFIX ? node->prefix_size
+                                                  : MAX_PREFIX;
+        memcpy(prefix, node->prefix, n);
+        if (n < MAX_PREFIX)
+            prefix[n++] = n4->keys[0];
+        size_t i;
+        for (i = 0; n < MAX_PREFIX && i < child->prefix_size; i++)
+            prefix[n++] = child->prefix[i];
+        memcpy(child->prefix, prefix, n);
+        child->prefix_size += node->prefix_size + 1;
+    }
+    *pref = child;
+    fsfree(node);
+}
+
+static void shrink(node_t **pref)
+{
+    node_t *node = *pref;
+    switch (node->type) {
+        case NODE4:
+            if (node->count + (node->terminal != NULL) == 1)
+                collapse(pref);
+            break;
+        case NODE16:
+            if (node->count <= 3)
+                *pref = resize(node, NODE4);
+            break;
+        case NODE48:
+            if (node->count <= 12)
+                *pref = resize(node, NODE16);
+            break;
+        default:
+            if (node->count <= 37)
+                *pref = resize(node, NODE48);
+    }
+}
+
+/* Return how many bytes of the prefix of node match the key from depth
+ * on. Bytes beyond the stored part of the prefix are read from a
+ * leaf. */
+static size_t match_prefix(node_t *node, const uint8_t *key, size_t size,
+                           size_t depth)
+{
+    size_t limit = node->prefix_size;
+    if (limit > size - depth)
+        limit = size - depth;
+    size_t i, n = limit < MAX_PREFIX ? limit : MAX_PREFIX;
+    for (i = 0; i < n; i++)
+        if (node->prefix[i] != key[depth + i])
+            return i;
+    if (i < limit) {
+        const uint8_t *bytes = minimum(node)->key;
+        for (; i < limit; i++)
+            if (bytes[depth + i] != key[depth + i])
+                return i;
+    }
+    return i;
+}
+
+static leaf_t *make_leaf(const void *key, size_t size, const void *value)
+{
+    leaf_t *leaf = fsalloc(sizeof *leaf);
+    leaf->key = key;
+    leaf->size = size;
+    leaf->value = value;
+    return leaf;
+}
+
+/* Add a leaf to a node whose prefix ends at depth. */
+static void place(node_t *node, leaf_t *leaf, size_t depth)
+{
+    if (leaf->size == depth)
+        node->terminal = leaf;
+    else
+        insert_child(node, ((const uint8_t *) leaf->key)[depth],
+                     leaf_ref(leaf));
+}
+
+static node_t *split_leaf(leaf_t *other, leaf_t *leaf, size_t depth)
+{
+    const uint8_t *key1 = other->key, *key2 = leaf->key;
+    size_t limit = other->size < leaf->size ? other->size : leaf->size;
+    size_t i = depth;
+    while (i < limit && key1[i] == key2[i])
+        i++;
+    node_t *node = make_node(NODE4);
+    set_prefix(node, key2 + depth, i - depth);
+    place(node, other, i);
+    place(node, leaf, i);
+    return node;
+}
+
+static node_t *split_prefix(node_t *node, leaf_t *leaf, size_t depth,
+                            size_t matched)
+{
+    const uint8_t *bytes = node->prefix;
+    if (node->prefix_size > MAX_PREFIX)
+        bytes = (const uint8_t *) minimum(node)->key + depth;
+    node_t *parent = make_node(NODE4);
+    set_prefix(parent, (const uint8_t *) leaf->key + depth, matched);
+    uint8_t byte = bytes[matched];
+    set_prefix(node, bytes + matched + 1, node->prefix_size - matched - 1);
+    insert_child(parent, byte, node);
+    place(parent, leaf, depth + matched);
+    return parent;
+}
+
+/* Add a leaf to the tree unless its key is there already, in which case
+ * the leaf with the key is returned. */
+static leaf_t *insert(node_t **pref, leaf_t *leaf)
+{
+    const uint8_t *key = leaf->key;
+    size_t size = leaf->size, depth = 0;
+    for (;;) {
+        node_t *ref = *pref;
+        if (!ref) {
+            *pref = leaf_ref(leaf);
+            return NULL;
+        }
+        if (is_leaf(ref)) {
+            leaf_t *other = leaf_of(ref);
+            if (leaf_matches(other, key, size))
+                return other;
+            *pref = split_leaf(other, leaf, depth);
+            return NULL;
+        }
+        size_t matched = match_prefix(ref, key, size, depth);
+        if (matched < ref->prefix_size) {
+            *pref = split_prefix(ref, leaf, depth, matched);
+            return NULL;
+        }
+        depth += matched;
+        if (depth == size) {
+            if (ref->terminal)
+                return ref->terminal;
+            ref->terminal = leaf;
+            return NULL;
+        }
+        node_t **pchild = find_child(ref, key[depth]);
+        if (!pchild) {
+            add_child(pref, key[depth], leaf_ref(leaf));
+            return NULL;
+        }
+        pref = pchild;
+        depth++;
+    }
+}
+
+bool radix_tree_put(radix_tree_t *tree, const void *key, size_t size,
+                    const void *value, const void **pold_key,
+                    const void **pold_value)
+{
+    leaf_t *leaf = make_leaf(key, size, value);
+    leaf_t *existing = insert(&tree->root, leaf);
+    if (!existing) {
+        tree->size++;
+        return false;
+    }
+    if (pold_key)
+        *pold_key = existing->key;
+    if (pold_value)
+        *pold_value = existing->value;
+    existing->key = key;
+    existing->value = value;
+    fsfree(leaf);
+    return true;
+}
+
+/* The prefixes are checked only partially on the way down, and the key
+ * is compared with the leaf in the end. */
+static leaf_t *lookup(radix_tree_t *tree, const uint8_t *key, size_t size)
+{
+    node_t *ref = tree->root;
+    size_t depth = 0;
+    while (ref && !is_leaf(ref)) {
+        size_t n =
+            ref->prefix_size < MAX_PREFIX ? ref->prefix_size : MAX_PREFIX;
+        if (ref->prefix_size > size - depth ||
+            memcmp(ref->prefix, key + depth, n))
+            return NULL;
+        depth += ref->prefix_size;
+        if (depth == size) {
+            leaf_t *leaf = ref->terminal;
+            return leaf && leaf_matches(leaf, key, size) ? leaf : NULL;
+        }
+        node_t **pchild = find_child(ref, key[depth++]);
+        if (!pchild)
+            return NULL;
+        ref = *pchild;
+    }
+    if (!ref || !leaf_matches(leaf_of(ref), key, size))
+        return NULL;
+    return leaf_of(ref);
+}
+
+bool radix_tree_get(radix_tree_t *tree, const void *key, size_t size,
+                    const void **pvalue)
+{
+    leaf_t *leaf = lookup(tree, key, size);
+    if (!leaf)
+        return false;
+    if (pvalue)
+        *pvalue = leaf->value;
+    return true;
+}
+
+static leaf_t *remove_key(node_t **pref, const uint8_t *key, size_t size,
+                          size_t depth)
+{
+    node_t *ref = *pref;
+    if (is_leaf(ref)) {
+        leaf_t *leaf = leaf_of(ref);
+        if (!leaf_matches(leaf, key, size))
+            return NULL;
+        *pref = NULL;
+        return leaf;
+    }
+    if (match_prefix(ref, key, size, depth) < ref->prefix_size)
+        return NULL;
+    depth += ref->prefix_size;
+    leaf_t *leaf;
+    if (depth == size) {
+        leaf = ref->terminal;
+        if (!leaf)
+            return NULL;
+        ref->terminal = NULL;
+    } else {
+        node_t **pchild = find_child(ref, key[depth]);
+        if (!pchild)
+            return NULL;
+        leaf = remove_key(pchild, key, size, depth + 1);
+        if (!leaf || *pchild)
+            return leaf;
+        remove_child(ref, key[depth]);
+    }
+    shrink(pref);
+    return leaf;
+}
+
+bool radix_tree_pop(radix_tree_t *tree, const void *key, size_t size,
+                    const void **pkey, const void **pvalue)
+{
+    if (!tree->root)
+        return false;
+    leaf_t *leaf = remove_key(&tree->root, key, size, 0);
+    if (!leaf)
+        return false;
+    tree->size--;
+    if (pkey)
+        *pkey = leaf->key;
+    if (pvalue)
+        *pvalue = leaf->value;
+    fsfree(leaf);
+    return true;
+}
+
+static bool visit(node_t *ref,
+                  bool (*cb)(const void *, size_t, const void *, void *),
+                  void *arg)
+{
+    if (is_leaf(ref)) {
+        leaf_t *leaf = leaf_of(ref);
+        return cb(leaf->key, leaf->size, leaf->value, arg);
+    }
+    leaf_t *leaf = ref->terminal;
+    if (leaf && !cb(leaf->key, leaf->size, leaf->value, arg))
+        return false;
+    unsigned cursor = 0;
+    node_t *child;
+    while ((child = next_child(ref, &cursor)))
+        if (!visit(child, cb, arg))
+            return false;
+    return true;
+}
+
+bool radix_tree_foreach(radix_tree_t *tree,
+                        bool (*cb)(const void *key, size_t size,
+                                   const void *value, void *arg),
+                        void *arg)
+{
+    return !tree->root || visit(tree->root, cb, arg);
+}
+
+bool radix_tree_scan_prefix(radix_tree_t *tree, const void *prefix,
+                            size_t size,
+                            bool (*cb)(const void *key, size_t key_size,
+                                       const void *value, void *arg),
+                            void *arg)
+{
+    const uint8_t *bytes = prefix;
+    node_t *ref = tree->root;
+    size_t depth = 0;
+    while (ref) {
+        if (is_leaf(ref)) {
+            leaf_t *leaf = leaf_of(ref);
+            if (leaf->size < size || memcmp(leaf->key, bytes, size))
+                return true;
+            return cb(leaf->key, leaf->size, leaf->value, arg);
+        }
+        size_t matched = match_prefix(ref, bytes, size, depth);
+        if (depth + matched == size)
+            return visit(ref, cb, arg);
+        if (matched < ref->prefix_size)
+            return true;
+        depth += matched;
+        node_t **pchild = find_child(ref, bytes[depth++]);
+        if (!pchild)
+            return true;
+        ref = *pchild;
+    }
+    return true;
+}
+
+bool radix_tree_longest_prefix(radix_tree_t *tree, const void *key,
+                               size_t size, const void **pkey,
+                               size_t *pkey_size, const void **pvalue)
+{
+    const uint8_t *bytes = key;
+    leaf_t *best = NULL;
+    node_t *ref = tree->root;
+    size_t depth = 0;
+    while (ref) {
+        if (is_leaf(ref)) {
+            leaf_t *leaf = leaf_of(ref);
+            if (leaf->size <= size && !memcmp(leaf->key, bytes, leaf->size))
+                best = leaf;
+            break;
+        }
+        if (match_prefix(ref, bytes, size, depth) < ref->prefix_size)
+            break;
+        depth += ref->prefix_size;
+        if (ref->terminal)
+            best = ref->terminal;
+        if (depth == size)
+            break;
+        node_t **pchild = find_child(ref, bytes[depth++]);
+        if (!pchild)
+            break;
+        ref = *pchild;
+    }
+    if (!best)
+        return false;
+    if (pkey)
+        *pkey = best->key;
+    if (pkey_size)
+        *pkey_size = best->size;
+    if (pvalue)
+        *pvalue = best->value;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef __FSDYN_SPINLOCK__
+#define __FSDYN_SPINLOCK__
+
+#include <sched.h>
+#include <stdbool.h>
+
+/*
+ * A minimal test-and-test-and-set lock for short critical sections.
+ * It keeps the library free of a threading library dependency. After
+ * spinning for a while, the waiter yields the processor in case the
+ * holder has been preempted.
+ */
+
+typedef unsigned spinlock_t;
+
+enum {
+    SPINLOCK_SPINS = 100,
+};
+
+static inline void spinlock_init(spinlock_t *lock)
+{
+    *lock = 0;
+}
+
+static inline bool spinlock_try_acquire(spinlock_t *lock)
+{
+    return !__atomic_load_n(lock, __ATOMIC_RELAXED) &&
+        !__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spinlock_acquire(spinlock_t *lock)
+{
+    unsigned spins = 0;
+    while (!spinlock_try_acquire(lock))
+        if (++spins == SPINLOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+}
+
+static inline void spinlock_release(spinlock_t *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+#endif
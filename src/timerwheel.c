@@ -0,0 +1,227 @@
+#include "timerwheel.h"
+
+#include "fsalloc.h"
+#include "fsdyn_version.h"
+
+enum {
+    SLOT_BITS = 6,
+    SLOTS = 1 << SLOT_BITS,
+    LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS,
+};
+
+struct timer_wheel_elem {
+    uint64_t expiry;
+    const void *value;
+    timer_wheel_elem_t *previous, *next;
+    uint8_t level, slot;
+};
+
+/* A timer is kept at the level of the highest SLOT_BITS-bit digit in
+ * which its expiry differs from the current time, in the slot given by
+ * that digit of the expiry. Thus, a slot at level 0 holds the timers of
+ * a single tick, a nonempty slot at level l > 0 is always ahead of the
+ * current time, and the timers of a lower level expire before those of
+ * a higher level. Timers scheduled in the past are kept in the slot of
+ * the current time at level 0.
+ *
+ * Expired and canceled elements are recycled through a free list. */
+struct timer_wheel {
+    uint64_t now;
+    size_t size;
+    uint64_t occupied[LEVELS]; /* bitmaps of nonempty slots */
+    timer_wheel_elem_t *slots[LEVELS][SLOTS];
+    timer_wheel_elem_t *free_elements;
+};
+
+timer_wheel_t *make_timer_wheel(uint64_t now)
+{
+    timer_wheel_t *wheel = fscalloc(1, sizeof *wheel);
+    wheel->now = now;
+    return wheel;
+}
+
+static void free_chain(timer_wheel_elem_t *element)
+{
+    while (element) {
+        timer_wheel_elem_t *next = element->next;
+        fsfree(element);
+        element = next;
+    }
+}
+
+void destroy_timer_wheel(timer_wheel_t *wheel)
+{
+    int level, slot;
+    for (level = 0; level < LEVELS; level++)
+        for (slot = 0; slot < SLOTS; slot++)
+            free_chain(wheel->slots[level][slot]);
+    free_chain(wheel->free_elements);
+    fsfree(wheel);
+}
+
+size_t timer_wheel_size(timer_wheel_t *wheel)
+{
+    return wheel->size;
+}
+
+bool timer_wheel_empty(timer_wheel_t *wheel)
+{
+    return wheel->size == 0;
+}
+
+uint64_t timer_wheel_now(timer_wheel_t *wheel)
+{
+    return wheel->now;
+}
+
+uint64_t timer_wheel_elem_get_expiry(timer_wheel_elem_t *element)
+{
+    return element->expiry;
+}
+
+const void *timer_wheel_elem_get_value(timer_wheel_elem_t *element)
+{
+    return element->value;
+}
+
+static void link_element(timer_wheel_t *wheel, timer_wheel_elem_t *element)
+{
+    uint64_t expiry = element->expiry;
+    if (expiry < wheel->now)
+        expiry = wheel->now;
+    uint64_t difference = expiry ^ wheel->now;
+    unsigned level = 0;
+    if (difference)
+        level = (63 - __builtin_clzll(difference)) / SLOT_BITS;
+    unsigned slot = expiry >> level * SLOT_BITS & (SLOTS - 1);
+    element->level = level;
+    element->slot = slot;
+    timer_wheel_elem_t **head = &wheel->slots[level][slot];
+    element->previous = NULL;
+    element->next = *head;
+    if (*head)
+        (*head)->previous = element;
+    *head = element;
+    wheel->occupied[level] |= (uint64_t) 1 << slot;
+}
+
+static void unlink_element(timer_wheel_t *wheel, timer_wheel_elem_t *element)
+{
+    if (element->next)
+        element->next->previous = element->previous;
+    if (element->previous) {
+        element->previous->next = element->next;
+        return;
+    }
+    wheel->slots[element->level][element->slot] = element->next;
+    if (!element->next)
+        wheel->occupied[element->level] &= ~((uint64_t) 1 << element->slot);
+}
+
+timer_wheel_elem_t *timer_wheel_schedule(timer_wheel_t *wheel,
+                                         uint64_t expiry, const void *value)
+{
+    timer_wheel_elem_t *element = wheel->free_elements;
+    if (element)
+        wheel->free_elements = element->next;
+    else
+        element = fsalloc(sizeof *element);
+    element->expiry = expiry;
+    element->value = value;
+    link_element(wheel, element);
+    wheel->size++;
+    return element;
+}
+
+/* Remove an element from the wheel and return its value. */
+static const void *release(timer_wheel_t *wheel, timer_wheel_elem_t *element)
+{
+    unlink_element(wheel, element);
+    wheel->size--;
+    element->next = wheel->free_elements;
+    wheel->free_elements = element;
+    return element->value;
+}
+
+const void *timer_wheel_cancel(timer_wheel_t *wheel,
+                               timer_wheel_elem_t *element)
+{
+    return release(wheel, element);
+}
+
+/* Return the level of the earliest nonempty slot, or -1 if the wheel
+ * is empty. */
+static int first_level(timer_wheel_t *wheel)
+{
+    int level;
+    for (level = 0; level < LEVELS; level++)
+        if (wheel->occupied[level])
+            return level;
+    return -1;
+}
+
+/* Return the first tick of a slot. */
+static uint64_t slot_start(timer_wheel_t *wheel, unsigned level,
+                           unsigned slot)
+{
+    unsigned shift = level * SLOT_BITS;
+    uint64_t high = 0;
+    if (shift + SLOT_BITS < 64)
+        high = wheel->now >> (shift + SLOT_BITS) << (shift + SLOT_BITS);
+    return high | (uint64_t) slot << shift;
+}
+
+bool timer_wheel_next_expiry(timer_wheel_t *wheel, uint64_t *pexpiry)
+{
+    int level = first_level(wheel);
+    if (level < 0)
+        return false;
+    unsigned slot = __builtin_ctzll(wheel->occupied[level]);
+    timer_wheel_elem_t *element = wheel->slots[level][slot];
+    uint64_t expiry = element->expiry;
+    for (element = element->next; element; element = element->next)
+        if (element->expiry < expiry)
+            expiry = element->expiry;
+    *pexpiry = expiry;
+    return true;
+}
+
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now,
+                           void (*cb)(const void *value, void *arg),
+                           void *arg)
+{
+    if (now < wheel->now)
+        now = wheel->now;
+    size_t count = 0;
+    for (;;) {
+        int level = first_level(wheel);
+        if (level < 0)
+            break;
+        unsigned slot = __builtin_ctzll(wheel->occupied[level]);
+        uint64_t start = slot_start(wheel, level, slot);
+        if (start > now)
+            break;
+        wheel->now = start;
+        timer_wheel_elem_t **head = &wheel->slots[level][slot];
+        if (level == 0) {
+            /* Take one timer at a time so cb() may schedule and cancel
+             * timers in the same slot. */
+            while (*head) {
+                cb(release(wheel, *head), arg);
+                count++;
+            }
+            continue;
+        }
+        /* The slot has come within reach of a lower level. */
+        timer_wheel_elem_t *element = *head;
+        *head = NULL;
+        wheel->occupied[level] &= ~((uint64_t) 1 << slot);
+        while (element) {
+            timer_wheel_elem_t *next = element->next;
+            link_element(wheel, element);
+            element = next;
+        }
+    }
+    wheel->now = now;
+    return count;
+}
@@ -1,7 +1,9 @@
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "avltree.h"
@@ -21,6 +23,7 @@ static element_t elements[N];
 static avl_tree_t *tree;
 static avl_tree_t *tree_ordered;
 static avl_tree_t *tree_reverse;
+static avl_tree_t *tree_sorted;
 
 static void prepare_data(void)
 {
@@ -89,6 +92,12 @@ __attribute__((unused)) static void print_tree(avl_tree_t *t)
 
 static void verify_node(avl_elem_t *node)
 {
+    size_t count = 1;
+    if (node->left != NULL)
+        count += node->left->count;
+    if (node->right != NULL)
+        count += node->right->count;
+    assert(node->count == count);
     if (node->left != NULL) {
         assert(node->left->parent == node);
         verify_node(node->left);
@@ -99,12 +108,23 @@ static void verify_node(avl_elem_t *node)
     }
 }
 
+static int verify_balance(avl_elem_t *node)
+{
+    if (node == NULL)
+        return 0;
+    int left = verify_balance(node->left);
+    int right = verify_balance(node->right);
+    assert(node->balance == right - left);
+    return 1 + (left > right ? left : right);
+}
+
 static void verify_structure(avl_tree_t *t)
 {
     if (t->root == NULL)
         return;
     assert(t->root->parent == NULL);
     verify_node(t->root);
+    verify_balance(t->root);
 }
 
 static void test_tree_size(avl_tree_t *t, int size)
@@ -158,6 +178,31 @@ static void verify_order(avl_tree_t *t)
     }
 }
 
+static void verify_rank(avl_tree_t *t)
+{
+    size_t rank = 0;
+    avl_elem_t *node;
+    for (node = avl_tree_get_first(t); node; node = avl_tree_next(node)) {
+        assert(avl_tree_get_by_rank(t, rank) == node);
+        assert(avl_tree_rank(t, node->key) == rank);
+        assert(avl_elem_get_rank(node) == rank);
+        rank++;
+    }
+    assert(avl_tree_get_by_rank(t, rank) == NULL);
+}
+
+static void verify_replace(avl_tree_t *t)
+{
+    avl_elem_t *node = avl_tree_get_by_rank(t, t->size / 2);
+    if (node == NULL)
+        return;
+    const void *key = node->key, *value = node->value;
+    avl_elem_t *old = avl_tree_put(t, key, value);
+    assert(old == node);
+    destroy_avl_element(old);
+    verify_structure(t);
+}
+
 static void verify_copy(avl_tree_t *t)
 {
     avl_tree_t *copy = avl_tree_copy(t);
@@ -194,6 +239,10 @@ static void verify_tree(avl_tree_t *t, int size, const char *label)
     verify_height(t, size);
     printf("verify_order (%s:%d)\n", label, size);
     verify_order(t);
+    printf("verify_rank (%s:%d)\n", label, size);
+    verify_rank(t);
+    printf("verify_replace (%s:%d)\n", label, size);
+    verify_replace(t);
     printf("verify_copy (%s:%d)\n", label, size);
     verify_copy(t);
 }
@@ -234,6 +283,347 @@ static void enter_reverse_data(void)
     }
 }
 
+static void enter_sorted_data(void)
+{
+    const void **keys = malloc(N * sizeof *keys);
+    const void **values = malloc(N * sizeof *values);
+    int i = 0;
+    avl_elem_t *node;
+    for (node = avl_tree_get_first(tree); node != NULL;
+         node = avl_tree_next(node)) {
+        keys[i] = avl_elem_get_key(node);
+        values[i++] = avl_elem_get_value(node);
+    }
+    tree_sorted = make_avl_tree(keycmp);
+    const void *swapped[2] = { keys[1], keys[0] };
+    assert(!avl_tree_build_sorted_checked(tree_sorted, swapped, NULL, 2));
+    assert(errno == EINVAL);
+    assert(avl_tree_empty(tree_sorted));
+    assert(avl_tree_build_sorted_checked(tree_sorted, keys, values, N));
+    assert(!avl_tree_build_sorted_checked(tree_sorted, keys, values, N));
+    assert(errno == EEXIST);
+    avl_tree_t *small = make_avl_tree(keycmp);
+    for (i = 0; i < 100; i++) {
+        avl_tree_build_sorted(small, keys, NULL, i);
+        verify_structure(small);
+        test_tree_size(small, i);
+        node = avl_tree_get_first(small);
+        if (node)
+            assert(avl_elem_get_value(node) == keys[0]);
+        destroy_avl_tree(small);
+        small = make_avl_tree(keycmp);
+    }
+    destroy_avl_tree(small);
+    free(keys);
+    free(values);
+}
+
+enum {
+    M = 20000,
+};
+
+static avl_tree_t *make_subset(int modulus, const void *value)
+{
+    avl_tree_t *t = make_avl_tree(keycmp);
+    int i;
+    for (i = 0; i < M; i += modulus)
+        avl_tree_put(t, elements[i].key, value ? value : &elements[i]);
+    return t;
+}
+
+static void verify_joined(avl_tree_t *t, int size)
+{
+    verify_structure(t);
+    test_tree_size(t, size);
+    verify_height(t, size);
+    verify_order(t);
+}
+
+static void test_split_join(void)
+{
+    avl_tree_t *t = make_subset(1, NULL);
+    int round;
+    for (round = 0; round < 100; round++) {
+        element_t *pivot = &elements[random() % (M + 100)];
+        int below = avl_tree_rank(t, pivot->key);
+        avl_tree_t *upper = avl_tree_split(t, pivot->key);
+        verify_joined(t, below);
+        verify_joined(upper, M - below);
+        avl_elem_t *node = avl_tree_get_last(t);
+        if (node)
+            assert(keycmp(node->key, pivot->key) < 0);
+        node = avl_tree_get_first(upper);
+        if (node)
+            assert(keycmp(node->key, pivot->key) >= 0);
+        avl_tree_join(t, upper);
+        assert(avl_tree_empty(upper));
+        destroy_avl_tree(upper);
+        verify_joined(t, M);
+    }
+    /* Join trees of very different heights both ways. */
+    avl_tree_t *upper = avl_tree_split(t, avl_tree_get_by_rank(t, 3)->key);
+    avl_tree_join(t, upper);
+    verify_joined(t, M);
+    destroy_avl_tree(upper);
+    upper = avl_tree_split(t, avl_tree_get_by_rank(t, M - 3)->key);
+    avl_tree_join(t, upper);
+    verify_joined(t, M);
+    destroy_avl_tree(upper);
+    destroy_avl_tree(t);
+}
+
+static void count_discarded(const void *key, const void *value, void *arg)
+{
+    (*(int *) arg)++;
+}
+
+static int subset_size(int modulus)
+{
+    return (M + modulus - 1) / modulus;
+}
+
+static void test_set_operations(void)
+{
+    static const char other;
+    int discarded = 0;
+    avl_tree_t *t1 = make_subset(2, NULL);
+    avl_tree_t *t2 = make_subset(3, &other);
+    avl_tree_union(t1, t2, count_discarded, &discarded);
+    assert(discarded == subset_size(6));
+    verify_joined(t1, subset_size(2) + subset_size(3) - subset_size(6));
+    int i;
+    for (i = 0; i < M; i++) {
+        avl_elem_t *node = avl_tree_get(t1, elements[i].key);
+        if (i % 2 == 0)
+            assert(node && node->value == &elements[i]);
+        else if (i % 3 == 0)
+            assert(node && node->value == &other);
+        else
+            assert(!node);
+    }
+    assert(avl_tree_empty(t2));
+    destroy_avl_tree(t2);
+    destroy_avl_tree(t1);
+
+    discarded = 0;
+    t1 = make_subset(2, NULL);
+    t2 = make_subset(3, &other);
+    avl_tree_intersection(t1, t2, count_discarded, &discarded);
+    assert(discarded == subset_size(2) + subset_size(3) - subset_size(6));
+    verify_joined(t1, subset_size(6));
+    for (i = 0; i < M; i++) {
+        avl_elem_t *node = avl_tree_get(t1, elements[i].key);
+        assert((node != NULL) == (i % 6 == 0));
+        assert(!node || node->value == &elements[i]);
+    }
+    destroy_avl_tree(t2);
+    destroy_avl_tree(t1);
+
+    discarded = 0;
+    t1 = make_subset(2, NULL);
+    t2 = make_subset(3, &other);
+    avl_tree_difference(t1, t2, count_discarded, &discarded);
+    assert(discarded == subset_size(3) + subset_size(6));
+    verify_joined(t1, subset_size(2) - subset_size(6));
+    for (i = 0; i < M; i++)
+        assert((avl_tree_get(t1, elements[i].key) != NULL) ==
+               (i % 2 == 0 && i % 3 != 0));
+    destroy_avl_tree(t2);
+    destroy_avl_tree(t1);
+
+    t1 = make_subset(1, NULL);
+    t2 = make_avl_tree(keycmp);
+    avl_tree_intersection(t1, t2, NULL, NULL);
+    assert(avl_tree_empty(t1));
+    destroy_avl_tree(t2);
+    destroy_avl_tree(t1);
+}
+
+typedef struct {
+    const void *lo, *hi, *previous;
+    int count;
+} range_check_t;
+
+static void check_removed(const void *key, const void *value, void *arg)
+{
+    range_check_t *check = arg;
+    assert(keycmp(key, check->lo) >= 0 && keycmp(key, check->hi) < 0);
+    assert(!check->previous || keycmp(check->previous, key) < 0);
+    assert(value == key);
+    check->previous = key;
+    check->count++;
+}
+
+static void test_ranges(void)
+{
+    avl_tree_t *t = make_subset(1, NULL);
+    int size = M, round;
+    for (round = 0; round < 50; round++) {
+        const uint8_t *lo = elements[random() % (M + 100)].key;
+        const uint8_t *hi = elements[random() % (M + 100)].key;
+        if (round % 10 == 0)
+            hi = lo;
+        int expected = 0;
+        avl_elem_t *node;
+        for (node = avl_tree_get_first(t); node; node = avl_tree_next(node))
+            if (keycmp(node->key, lo) >= 0 && keycmp(node->key, hi) < 0)
+                expected++;
+        assert(avl_tree_count_range(t, lo, hi) == expected);
+        range_check_t check = { lo, hi, NULL, 0 };
+        assert(avl_tree_remove_range(t, lo, hi, check_removed, &check) ==
+               expected);
+        assert(check.count == expected);
+        size -= expected;
+        verify_joined(t, size);
+        assert(avl_tree_count_range(t, lo, hi) == 0);
+    }
+    destroy_avl_tree(t);
+}
+
+static int comparisons;
+
+static int counting_keycmp(const void *key1, const void *key2)
+{
+    comparisons++;
+    return keycmp(key1, key2);
+}
+
+static void test_cursor(const void **keys, int step)
+{
+    avl_tree_t *t = make_avl_tree(counting_keycmp);
+    avl_cursor_t *cursor = make_avl_cursor(t);
+    comparisons = 0;
+    int i;
+    for (i = 0; i < M; i++) {
+        /* Nearly sorted: swap some neighbors. */
+        int j = step > 0 ? i : M - 1 - i;
+        if (j % 7 == 3)
+            j -= step;
+        else if (j % 7 == 3 - step)
+            j += step;
+        assert(avl_cursor_put(cursor, keys[j], keys[j]) == NULL);
+    }
+    assert(comparisons < 4 * M);
+    verify_joined(t, M);
+    avl_elem_t *old = avl_cursor_put(cursor, keys[0], &elements[0]);
+    assert(old && avl_elem_get_value(old) == keys[0]);
+    destroy_avl_element(old);
+    avl_cursor_reset(cursor);
+    old = avl_cursor_put(cursor, keys[M - 1], &elements[0]);
+    assert(old && avl_elem_get_value(old) == keys[M - 1]);
+    destroy_avl_element(old);
+    verify_joined(t, M);
+    destroy_avl_cursor(cursor);
+    destroy_avl_tree(t);
+}
+
+static void test_put_hint(void)
+{
+    const void **keys = malloc(M * sizeof *keys);
+    avl_tree_t *t = make_subset(1, NULL);
+    int i = 0;
+    avl_elem_t *node;
+    for (node = avl_tree_get_first(t); node; node = avl_tree_next(node))
+        keys[i++] = node->key;
+    destroy_avl_tree(t);
+    test_cursor(keys, 1);
+    test_cursor(keys, -1);
+
+    t = make_avl_tree(keycmp);
+    for (i = 0; i < M; i++) {
+        const void *key = elements[i].key;
+        avl_elem_t *hint = i ? avl_tree_get_by_rank(t, random() % i) : NULL;
+        assert(avl_tree_put_hint(t, hint, key, key) == NULL);
+    }
+    verify_joined(t, M);
+    for (i = 0; i < M; i++) {
+        avl_elem_t *hint = avl_tree_get_by_rank(t, random() % M);
+        avl_elem_t *old = avl_tree_put_hint(t, hint, keys[i], keys[i]);
+        assert(old && keycmp(avl_elem_get_key(old), keys[i]) == 0);
+        destroy_avl_element(old);
+    }
+    verify_joined(t, M);
+    destroy_avl_tree(t);
+    free(keys);
+}
+
+/* Augment every element with the size of its subtree, which can be
+ * checked against the count field. */
+static size_t subtree_sizes[M];
+
+static void augment_size(avl_elem_t *element, void *obj)
+{
+    size_t *size = (size_t *) element->value;
+    *size = 1;
+    if (element->left)
+        *size += *(const size_t *) element->left->value;
+    if (element->right)
+        *size += *(const size_t *) element->right->value;
+}
+
+static void verify_augmented(avl_tree_t *t)
+{
+    verify_structure(t);
+    avl_elem_t *node;
+    for (node = avl_tree_get_first(t); node; node = avl_tree_next(node))
+        assert(*(const size_t *) node->value == node->count);
+}
+
+static void test_augment(void)
+{
+    avl_tree_t *t = make_avl_tree(keycmp);
+    t->augment = augment_size;
+    int i;
+    for (i = 0; i < M; i++) {
+        avl_elem_t *hint = i % 2 ? avl_tree_get_by_rank(t, random() % i) : NULL;
+        if (hint)
+            avl_tree_put_hint(t, hint, elements[i].key, &subtree_sizes[i]);
+        else
+            avl_tree_put(t, elements[i].key, &subtree_sizes[i]);
+    }
+    verify_augmented(t);
+    for (i = 0; i < M; i += 3) {
+        avl_elem_t *old = avl_tree_put(t, elements[i].key, &subtree_sizes[i]);
+        assert(old != NULL);
+        destroy_avl_element(old);
+    }
+    verify_augmented(t);
+    for (i = 0; i < M; i += 2)
+        avl_tree_remove(t, avl_tree_get(t, elements[i].key));
+    verify_augmented(t);
+    destroy_avl_tree(t);
+}
+
+typedef struct {
+    const void *previous;
+    int count;
+} destroy_check_t;
+
+static void check_destroyed(const void *key, const void *value, void *arg)
+{
+    destroy_check_t *check = arg;
+    assert(!check->previous || keycmp(check->previous, key) < 0);
+    assert(value == key);
+    check->previous = key;
+    check->count++;
+}
+
+static void test_destroy_incrementally(void)
+{
+    avl_tree_t *t = make_subset(1, NULL);
+    destroy_check_t check = { NULL, 0 };
+    int calls = 0, previous_count = 0;
+    while (!destroy_avl_tree_incrementally(t, 100, check_destroyed, &check)) {
+        assert(check.count - previous_count <= 100);
+        previous_count = check.count;
+        calls++;
+    }
+    assert(check.count == M);
+    assert(calls >= M / 100 && calls < 2 * M / 100);
+    t = make_avl_tree(keycmp);
+    assert(destroy_avl_tree_incrementally(t, 1, NULL, NULL));
+}
+
 int main(void)
 {
     printf("prepare_data\n");
@@ -242,8 +632,22 @@ int main(void)
     enter_data();
     enter_ordered_data();
     enter_reverse_data();
+    enter_sorted_data();
+    printf("test_split_join\n");
+    test_split_join();
+    printf("test_set_operations\n");
+    test_set_operations();
+    printf("test_ranges\n");
+    test_ranges();
+    printf("test_put_hint\n");
+    test_put_hint();
+    printf("test_augment\n");
+    test_augment();
+    printf("test_destroy_incrementally\n");
+    test_destroy_incrementally();
     do_tree(tree, N, "random");
     do_tree(tree_ordered, N, "ordered");
     do_tree(tree_reverse, N, "reverse");
+    do_tree(tree_sorted, N, "sorted");
     return 0;
 }
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/avltree.h>
+#include <fsdyn/btree.h>
+
+enum {
+    N = 20000,
+    ROUNDS = 200000,
+};
+
+static int context;
+
+/* The keys are allocated separately and freed as soon as they leave the
+ * tree so stale references to them are caught by memory checkers. */
+static int keycmp(const void *key1, const void *key2, void *obj)
+{
+    assert(obj == &context);
+    unsigned k1 = *(const unsigned *) key1, k2 = *(const unsigned *) key2;
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned *make_key(unsigned k)
+{
+    unsigned *key = malloc(sizeof *key);
+    *key = k;
+    return key;
+}
+
+static void verify(btree_t *tree, avl_tree_t *reference)
+{
+    assert(btree_size(tree) == avl_tree_size(reference));
+    assert(btree_empty(tree) == avl_tree_empty(reference));
+    btree_elem_t *element = btree_get_first(tree);
+    avl_elem_t *expected;
+    for (expected = avl_tree_get_first(reference); expected;
+         expected = avl_tree_next(expected)) {
+        assert(element);
+        assert(keycmp(btree_elem_get_key(element),
+                      avl_elem_get_key(expected), &context) == 0);
+        assert(btree_elem_get_value(element) == avl_elem_get_value(expected));
+        element = btree_next(element);
+    }
+    assert(!element);
+    element = btree_get_last(tree);
+    for (expected = avl_tree_get_last(reference); expected;
+         expected = avl_tree_previous(expected)) {
+        assert(element);
+        assert(btree_elem_get_value(element) == avl_elem_get_value(expected));
+        element = btree_previous(element);
+    }
+    assert(!element);
+}
+
+static void check_neighbors(btree_t *tree, avl_tree_t *reference, unsigned k)
+{
+    btree_elem_t *(*btree_get_fns[])(btree_t *, const void *) = {
+        btree_get,       btree_get_before, btree_get_on_or_before,
+        btree_get_after, btree_get_on_or_after,
+    };
+    avl_elem_t *(*avl_get_fns[])(avl_tree_t *, const void *) = {
+        avl_tree_get,       avl_tree_get_before, avl_tree_get_on_or_before,
+        avl_tree_get_after, avl_tree_get_on_or_after,
+    };
+    int i;
+    for (i = 0; i < 5; i++) {
+        btree_elem_t *element = btree_get_fns[i](tree, &k);
+        avl_elem_t *expected = avl_get_fns[i](reference, &k);
+        if (expected)
+            assert(element &&
+                   btree_elem_get_value(element) ==
+                       avl_elem_get_value(expected));
+        else
+            assert(!element);
+    }
+}
+
+static void test_random(void)
+{
+    btree_t *tree = make_btree_2(keycmp, &context);
+    avl_tree_t *reference = make_avl_tree_2(keycmp, &context);
+    static int values[N];
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        unsigned k = random() % N;
+        const void *old_key, *old_value;
+        /* Grow the tree in the first half and shrink it in the second. */
+        if (random() % 100 < (round < ROUNDS / 2 ? 70 : 30)) {
+            unsigned *key = make_key(k);
+            avl_elem_t *old = avl_tree_put(reference, key, &values[k]);
+            bool replaced =
+                btree_put(tree, key, &values[k], &old_key, &old_value);
+            assert(replaced == (old != NULL));
+            if (old) {
+                assert(old_key == avl_elem_get_key(old));
+                destroy_avl_element(old);
+                free((void *) old_key);
+            }
+        } else {
+            avl_elem_t *old = avl_tree_pop(reference, &k);
+            assert(btree_pop(tree, &k, &old_key, &old_value) == (old != NULL));
+            if (old) {
+                assert(old_key == avl_elem_get_key(old));
+                assert(old_value == &values[k]);
+                destroy_avl_element(old);
+                free((void *) old_key);
+            }
+        }
+        check_neighbors(tree, reference, random() % (N + 2));
+        if (round % (ROUNDS / 10) == 0)
+            verify(tree, reference);
+    }
+    verify(tree, reference);
+    const void *key;
+    bool last = false;
+    while (!btree_empty(tree)) {
+        avl_elem_t *expected = last ? avl_tree_pop_last(reference)
+                                    : avl_tree_pop_first(reference);
+        assert(last ? btree_pop_last(tree, &key, NULL)
+                    : btree_pop_first(tree, &key, NULL));
+        assert(key == avl_elem_get_key(expected));
+        destroy_avl_element(expected);
+        free((void *) key);
+        last = !last;
+    }
+    assert(!btree_pop_first(tree, NULL, NULL));
+    assert(!btree_get_first(tree) && !btree_get_last(tree));
+    verify(tree, reference);
+    destroy_btree(tree);
+    destroy_avl_tree(reference);
+}
+
+static int plain_cmp(const void *key1, const void *key2)
+{
+    return keycmp(key1, key2, &context);
+}
+
+static void test_sequential(void)
+{
+    static unsigned keys[N];
+    btree_t *tree = make_btree(plain_cmp);
+    unsigned i;
+    for (i = 0; i < N; i++) {
+        keys[i] = N - i;
+        assert(!btree_put(tree, &keys[i], NULL, NULL, NULL));
+    }
+    assert(btree_size(tree) == N);
+    btree_elem_t *element;
+    i = 1;
+    for (element = btree_get_first(tree); element;
+         element = btree_next(element))
+        assert(*(const unsigned *) btree_elem_get_key(element) == i++);
+    for (i = 0; i < N; i += 2)
+        assert(btree_pop(tree, &keys[i], NULL, NULL));
+    assert(btree_size(tree) == N / 2);
+    destroy_btree(tree);
+}
+
+int main()
+{
+    test_random();
+    test_sequential();
+    return EXIT_SUCCESS;
+}
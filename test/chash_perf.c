@@ -0,0 +1,122 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <fsdyn/chashtable.h>
+#include <fsdyn/hashtable.h>
+#include <fsdyn/integer.h>
+
+enum {
+    KEYS = 1000000,
+    OPERATIONS = 2000000, /* per thread */
+    WRITE_PERCENT = 10,
+    MAX_THREADS = 256,
+};
+
+static chash_table_t *chash;
+static hash_table_t *table;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t hash_key(const void *key)
+{
+    return hash_unsigned((unsigned_t *) key);
+}
+
+uint64_t now_ns()
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_usec * 1000;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void *run_chash(void *arg)
+{
+    uint64_t state = (uintptr_t) arg * 7919 + 1;
+    int i;
+    for (i = 0; i < OPERATIONS; i++) {
+        uint64_t r = next_random(&state);
+        unsigned_t *key = as_unsigned(r % KEYS);
+        if (r / KEYS % 100 < WRITE_PERCENT)
+            chash_table_put(chash, key, key, NULL, NULL);
+        else
+            chash_table_get(chash, key, NULL);
+    }
+    return NULL;
+}
+
+static void *run_locked(void *arg)
+{
+    uint64_t state = (uintptr_t) arg * 7919 + 1;
+    int i;
+    for (i = 0; i < OPERATIONS; i++) {
+        uint64_t r = next_random(&state);
+        unsigned_t *key = as_unsigned(r % KEYS);
+        pthread_mutex_lock(&table_lock);
+        if (r / KEYS % 100 < WRITE_PERCENT)
+            destroy_hash_element(hash_table_put(table, key, key));
+        else
+            hash_table_get(table, key);
+        pthread_mutex_unlock(&table_lock);
+    }
+    return NULL;
+}
+
+static double measure(void *(*run)(void *), int threads)
+{
+    pthread_t ids[MAX_THREADS];
+    uint64_t start = now_ns();
+    int i;
+    for (i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, run, (void *) (uintptr_t) i);
+    for (i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+    uint64_t finish = now_ns();
+    return (double) threads * OPERATIONS * 1000 / (finish - start);
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+    if (max_threads > MAX_THREADS)
+        max_threads = MAX_THREADS;
+    fprintf(stderr, "prepare_data\n");
+    chash = make_chash_table(KEYS, 4 * max_threads, hash_key, unsigned_cmp);
+    table = make_hash_table(KEYS, hash_key, unsigned_cmp);
+    uintptr_t k;
+    for (k = 0; k < KEYS; k += 2) {
+        chash_table_put(chash, as_unsigned(k), as_unsigned(k), NULL, NULL);
+        hash_table_put(table, as_unsigned(k), as_unsigned(k));
+    }
+    fprintf(stderr, "%d%% writes, Mops/s (speedup over 1 thread)\n",
+            WRITE_PERCENT);
+    fprintf(stderr, "threads   chash_table      mutex+hash_table\n");
+    double chash_base = 0, locked_base = 0;
+    int threads;
+    for (threads = 1; threads <= max_threads; threads++) {
+        double chash_rate = measure(run_chash, threads);
+        double locked_rate = measure(run_locked, threads);
+        if (threads == 1) {
+            chash_base = chash_rate;
+            locked_base = locked_rate;
+        }
+        fprintf(stderr, "%7d %8.2f (%5.2fx) %8.2f (%5.2fx)\n", threads,
+                chash_rate, chash_rate / chash_base, locked_rate,
+                locked_rate / locked_base);
+    }
+    destroy_chash_table(chash);
+    destroy_hash_table(table);
+    return EXIT_SUCCESS;
+}
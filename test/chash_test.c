@@ -0,0 +1,150 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/chashtable.h>
+#include <fsdyn/hashtable.h>
+#include <fsdyn/integer.h>
+
+enum {
+    N = 100000,
+    WRITERS = 4,
+    READERS = 4,
+    ROUNDS = 20,
+};
+
+static uintptr_t values[N];
+
+static uint64_t hash_key(const void *key)
+{
+    return hash_unsigned((unsigned_t *) key);
+}
+
+static void test_basic(void)
+{
+    chash_table_t *table = make_chash_table(0, 4, hash_key, unsigned_cmp);
+    uintptr_t i;
+    for (i = 0; i < N; i++) {
+        values[i] = i;
+        assert(!chash_table_put(table, as_unsigned(i), &values[i], NULL,
+                                NULL));
+    }
+    assert(chash_table_size(table) == N);
+    for (i = 0; i < N; i++) {
+        const void *value;
+        assert(chash_table_get(table, as_unsigned(i), &value));
+        assert(value == &values[i]);
+    }
+    assert(!chash_table_get(table, as_unsigned(N), NULL));
+    const void *old_key, *old_value;
+    assert(chash_table_put(table, as_unsigned(0), &values[1], &old_key,
+                           &old_value));
+    assert(as_uintptr(old_key) == 0 && old_value == &values[0]);
+    for (i = 0; i < N; i += 2) {
+        const void *key, *value;
+        assert(chash_table_pop(table, as_unsigned(i), &key, &value));
+        assert(as_uintptr(key) == i);
+    }
+    assert(!chash_table_pop(table, as_unsigned(0), NULL, NULL));
+    assert(chash_table_size(table) == N / 2);
+    for (i = 0; i < N; i++)
+        assert(chash_table_get(table, as_unsigned(i), NULL) == (i % 2 != 0));
+    destroy_chash_table(table);
+}
+
+/* Undo the scrambling of the table so the scrambled hash of key i is
+ * i << 32, whose low 32 bits are zero. On a 32-bit target, the tag
+ * must still not be EMPTY. */
+static uint64_t low_zero_hash(const void *key)
+{
+    uint64_t hash = (uint64_t) as_uintptr(key) << 32;
+    hash ^= hash >> 33;
+    hash *= 0x9cb4b2f8129337db;
+    hash ^= hash >> 33;
+    hash *= 0x4f74430c22a54005;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static void test_low_zero_hash(void)
+{
+    chash_table_t *table = make_chash_table(0, 4, low_zero_hash, unsigned_cmp);
+    uintptr_t i;
+    for (i = 0; i < 1000; i++)
+        assert(!chash_table_put(table, as_unsigned(i), &values[i], NULL,
+                                NULL));
+    for (i = 0; i < 1000; i++) {
+        const void *value;
+        assert(chash_table_get(table, as_unsigned(i), &value));
+        assert(value == &values[i]);
+    }
+    for (i = 0; i < 1000; i += 2)
+        assert(chash_table_pop(table, as_unsigned(i), NULL, NULL));
+    for (i = 0; i < 1000; i++)
+        assert(chash_table_get(table, as_unsigned(i), NULL) == (i % 2 != 0));
+    assert(chash_table_size(table) == 500);
+    destroy_chash_table(table);
+}
+
+static chash_table_t *shared;
+static volatile bool done;
+
+/* Writers churn the even keys of their own range; odd keys are never
+ * removed, so readers must always find them. */
+static void *write_keys(void *arg)
+{
+    uintptr_t first = (uintptr_t) arg * (N / WRITERS);
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        uintptr_t i;
+        for (i = first; i < first + N / WRITERS; i += 2)
+            chash_table_put(shared, as_unsigned(i), &values[i], NULL, NULL);
+        for (i = first; i < first + N / WRITERS; i += 2)
+            assert(chash_table_pop(shared, as_unsigned(i), NULL, NULL));
+    }
+    return NULL;
+}
+
+static void *read_keys(void *arg)
+{
+    uintptr_t i = (uintptr_t) arg;
+    while (!done) {
+        const void *value;
+        i = (i + 2) % N;
+        if (chash_table_get(shared, as_unsigned(i | 1), &value))
+            assert(value == &values[i | 1]);
+        else
+            assert(false);
+    }
+    return NULL;
+}
+
+static void test_concurrency(void)
+{
+    shared = make_chash_table(0, 16, hash_key, unsigned_cmp);
+    uintptr_t i;
+    for (i = 1; i < N; i += 2)
+        chash_table_put(shared, as_unsigned(i), &values[i], NULL, NULL);
+    pthread_t writers[WRITERS], readers[READERS];
+    for (i = 0; i < READERS; i++)
+        pthread_create(&readers[i], NULL, read_keys, (void *) i);
+    for (i = 0; i < WRITERS; i++)
+        pthread_create(&writers[i], NULL, write_keys, (void *) i);
+    for (i = 0; i < WRITERS; i++)
+        pthread_join(writers[i], NULL);
+    done = true;
+    for (i = 0; i < READERS; i++)
+        pthread_join(readers[i], NULL);
+    assert(chash_table_size(shared) == N / 2);
+    destroy_chash_table(shared);
+}
+
+int main()
+{
+    test_basic();
+    test_low_zero_hash();
+    test_concurrency();
+    return EXIT_SUCCESS;
+}
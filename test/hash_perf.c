@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <fsdyn/hashtable.h>
+
+enum {
+    MAX_SIZE = 4096,
+    TOTAL = 256 * 1024 * 1024, /* bytes hashed per measurement */
+};
+
+static uint8_t data[MAX_SIZE + 1];
+static uint8_t key[16];
+static volatile uint64_t sink;
+
+static void prepare_data(void)
+{
+    int i;
+    for (i = 0; i < MAX_SIZE; i++)
+        data[i] = random() % 255 + 1;
+    for (i = 0; i < 16; i++)
+        key[i] = random() % 256;
+}
+
+uint64_t now_ns()
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_usec * 1000;
+}
+
+static uint64_t old_blob(const void *blob, size_t size)
+{
+    return hash_blob(blob, size);
+}
+
+static uint64_t fast_blob(const void *blob, size_t size)
+{
+    return hash_blob_fast(blob, size);
+}
+
+static uint64_t keyed_blob(const void *blob, size_t size)
+{
+    return hash_blob_keyed(blob, size, key);
+}
+
+static uint64_t old_string(const void *blob, size_t size)
+{
+    return hash_string(blob);
+}
+
+static uint64_t fast_string(const void *blob, size_t size)
+{
+    return hash_string_fast(blob);
+}
+
+static void measure(const char *label, uint64_t (*hash)(const void *, size_t),
+                    size_t size)
+{
+    size_t n = TOTAL / (size + 16);
+    uint64_t result = 0;
+    uint64_t start = now_ns();
+    size_t i;
+    for (i = 0; i < n; i++)
+        result += hash(data, size);
+    uint64_t finish = now_ns();
+    sink = result;
+    fprintf(stderr, "  %-12s %4zu bytes: %8.2f ns/hash %6.2f GB/s\n", label,
+            size, (double) (finish - start) / n,
+            (double) n * size / (finish - start));
+}
+
+static void measure_string(const char *label,
+                           uint64_t (*hash)(const void *, size_t), size_t size)
+{
+    uint8_t saved = data[size];
+    data[size] = 0;
+    measure(label, hash, size);
+    data[size] = saved;
+}
+
+int main()
+{
+    fprintf(stderr, "prepare_data\n");
+    prepare_data();
+    static const size_t sizes[] = { 4, 8, 16, 32, 64, 256, 1024, MAX_SIZE };
+    size_t i;
+    for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+        size_t size = sizes[i];
+        fprintf(stderr, "measure blobs\n");
+        measure("hash_blob", old_blob, size);
+        measure("fast", fast_blob, size);
+        measure("keyed", keyed_blob, size);
+        fprintf(stderr, "measure strings\n");
+        measure_string("hash_string", old_string, size);
+        measure_string("fast", fast_string, size);
+    }
+    return EXIT_SUCCESS;
+}
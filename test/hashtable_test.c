@@ -0,0 +1,322 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fsdyn/hashtable.h>
+#include <fsdyn/integer.h>
+
+enum {
+    N = 100000,
+};
+
+static uintptr_t keys[N];
+static bool present[N];
+
+static void prepare_data(void)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        keys[i] = (uintptr_t) i * 7919;
+}
+
+static uint64_t hash_key(const void *key)
+{
+    return hash_unsigned((unsigned_t *) key);
+}
+
+static hash_table_t *enter_data(void)
+{
+    hash_table_t *table = make_hash_table(10, hash_key, unsigned_cmp);
+    int i;
+    for (i = 0; i < N; i++) {
+        hash_elem_t *old =
+            hash_table_put(table, as_unsigned(keys[i]), &keys[i]);
+        assert(old == NULL);
+        present[i] = true;
+    }
+    assert(hash_table_size(table) == N);
+    return table;
+}
+
+static void verify_contents(hash_table_t *table)
+{
+    size_t count = 0;
+    int i;
+    for (i = 0; i < N; i++) {
+        hash_elem_t *element = hash_table_get(table, as_unsigned(keys[i]));
+        if (!present[i]) {
+            assert(element == NULL);
+            continue;
+        }
+        assert(element != NULL);
+        assert(as_uintptr(hash_elem_get_key(element)) == keys[i]);
+        assert(hash_elem_get_value(element) == &keys[i]);
+        count++;
+    }
+    assert(hash_table_size(table) == count);
+    assert(hash_table_empty(table) == (count == 0));
+    size_t traversed = 0;
+    hash_elem_t *element;
+    for (element = hash_table_get_any(table); element;
+         element = hash_table_get_other(element)) {
+        const uintptr_t *value = hash_elem_get_value(element);
+        assert(present[value - keys]);
+        traversed++;
+    }
+    assert(traversed == count);
+}
+
+static void test_replace(hash_table_t *table)
+{
+    static uintptr_t other;
+    hash_elem_t *old = hash_table_put(table, as_unsigned(keys[0]), &other);
+    assert(old != NULL);
+    assert(hash_elem_get_value(old) == &keys[0]);
+    destroy_hash_element(old);
+    old = hash_table_put(table, as_unsigned(keys[0]), &other);
+    assert(old == NULL);
+    old = hash_table_put(table, as_unsigned(keys[0]), &keys[0]);
+    assert(old != NULL);
+    assert(hash_elem_get_value(old) == &other);
+    destroy_hash_element(old);
+    assert(hash_table_size(table) == N);
+}
+
+static void remove_elements(hash_table_t *table)
+{
+    int i;
+    for (i = 0; i < N; i += 2) {
+        hash_elem_t *element = hash_table_pop(table, as_unsigned(keys[i]));
+        assert(element != NULL);
+        destroy_hash_element(element);
+        present[i] = false;
+    }
+    for (i = 1; i < N; i += 4) {
+        hash_elem_t *element = hash_table_get(table, as_unsigned(keys[i]));
+        assert(element != NULL);
+        hash_table_remove(table, element);
+        present[i] = false;
+    }
+    assert(hash_table_pop(table, as_unsigned(keys[0])) == NULL);
+}
+
+static void reenter_elements(hash_table_t *table)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        if (!present[i]) {
+            assert(hash_table_put(table, as_unsigned(keys[i]), &keys[i]) ==
+                   NULL);
+            present[i] = true;
+        }
+}
+
+static void drain(hash_table_t *table)
+{
+    hash_elem_t *element;
+    while ((element = hash_table_pop_any(table)) != NULL) {
+        const uintptr_t *value = hash_elem_get_value(element);
+        assert(present[value - keys]);
+        present[value - keys] = false;
+        destroy_hash_element(element);
+    }
+    assert(hash_table_empty(table));
+}
+
+/* Detach every other element while traversing the table. */
+static void detach_while_traversing(hash_table_t *table)
+{
+    size_t count = hash_table_size(table), traversed = 0;
+    hash_elem_t *element, *next;
+    for (element = hash_table_get_any(table); element; element = next) {
+        next = hash_table_get_other(element);
+        const uintptr_t *value = hash_elem_get_value(element);
+        assert(present[value - keys]);
+        if (traversed++ % 2) {
+            hash_table_remove(table, element);
+            present[value - keys] = false;
+        }
+    }
+    assert(traversed == count);
+    assert(hash_table_size(table) == count - count / 2);
+}
+
+static void check_destroyed(const void *key, const void *value, void *arg)
+{
+    const uintptr_t *p = value;
+    assert(present[p - keys]);
+    assert(as_uintptr(key) == *p);
+    present[p - keys] = false;
+    ++*(size_t *) arg;
+}
+
+static void destroy_incrementally(hash_table_t *table)
+{
+    size_t count = 0, previous_count = 0;
+    while (!destroy_hash_table_incrementally(table, 1000, check_destroyed,
+                                             &count)) {
+        assert(count - previous_count == 1000);
+        previous_count = count;
+    }
+    assert(count == N);
+    int i;
+    for (i = 0; i < N; i++)
+        assert(!present[i]);
+}
+
+static void test_load_factor(void)
+{
+    hash_table_t *table = make_hash_table(0, hash_key, unsigned_cmp);
+    hash_table_set_max_load_factor(table, 0.25);
+    int i;
+    for (i = 0; i < N; i++)
+        present[i] = false;
+    for (i = 0; i < N; i++) {
+        assert(hash_table_put(table, as_unsigned(keys[i]), &keys[i]) == NULL);
+        present[i] = true;
+        if (i % 9973 == 0)
+            verify_contents(table);
+    }
+    verify_contents(table);
+    drain(table);
+    destroy_hash_table(table);
+}
+
+/* Empty a large table down to a few elements and churn them, leaving
+ * tombstones behind. */
+static void test_tombstones(void)
+{
+    hash_table_t *table = make_hash_table(0, hash_key, unsigned_cmp);
+    enum { WINDOW = 10 };
+    int i;
+    for (i = 0; i < N; i++) {
+        assert(hash_table_put(table, as_unsigned(keys[i]), &keys[i]) == NULL);
+        present[i] = true;
+    }
+    for (i = WINDOW; i < N; i++) {
+        destroy_hash_element(hash_table_pop(table, as_unsigned(keys[i])));
+        present[i] = false;
+    }
+    for (i = WINDOW; i < 10 * N; i++) {
+        int j = i % N, k = (i - WINDOW) % N;
+        assert(hash_table_put(table, as_unsigned(keys[j]), &keys[j]) == NULL);
+        present[j] = true;
+        destroy_hash_element(hash_table_pop(table, as_unsigned(keys[k])));
+        present[k] = false;
+        if (i % 99991 == 0)
+            verify_contents(table);
+    }
+    verify_contents(table);
+    drain(table);
+    destroy_hash_table(table);
+}
+
+static void test_hashed(void)
+{
+    hash_table_t *table1 = make_hash_table(0, hash_key, unsigned_cmp);
+    hash_table_t *table2 = make_hash_table(0, hash_key, unsigned_cmp);
+    int i;
+    for (i = 0; i < N; i++) {
+        unsigned_t *key = as_unsigned(keys[i]);
+        uint64_t hash = hash_key(key);
+        hash_table_t *table = i % 2 ? table1 : table2;
+        assert(hash_table_put_hashed(table, key, &keys[i], hash) == NULL);
+    }
+    for (i = 0; i < N; i++) {
+        unsigned_t *key = as_unsigned(keys[i]);
+        uint64_t hash = hash_key(key);
+        hash_elem_t *element1 = hash_table_get_hashed(table1, key, hash);
+        hash_elem_t *element2 = hash_table_get_hashed(table2, key, hash);
+        assert((element1 != NULL) == (i % 2 != 0));
+        assert((element2 != NULL) == (i % 2 == 0));
+        assert(hash_table_get(i % 2 ? table1 : table2, key) != NULL);
+    }
+    destroy_hash_table(table1);
+    destroy_hash_table(table2);
+}
+
+static void test_strings(void)
+{
+    hash_table_t *table =
+        make_hash_table(0, (void *) hash_string, (void *) strcmp);
+    static char names[1000][8];
+    int i;
+    for (i = 0; i < 1000; i++) {
+        snprintf(names[i], sizeof names[i], "k%d", i);
+        assert(hash_table_put(table, names[i], names[i]) == NULL);
+    }
+    for (i = 0; i < 1000; i++) {
+        char name[8];
+        snprintf(name, sizeof name, "k%d", i);
+        hash_elem_t *element = hash_table_get(table, name);
+        assert(element != NULL);
+        assert(hash_elem_get_value(element) == names[i]);
+    }
+    assert(hash_table_get(table, "k1000") == NULL);
+    destroy_hash_table(table);
+}
+
+static void test_hash_functions(void)
+{
+    /* Test vectors from the SipHash reference implementation */
+    uint8_t key[16], message[64];
+    int i;
+    for (i = 0; i < 16; i++)
+        key[i] = i;
+    for (i = 0; i < 64; i++)
+        message[i] = i;
+    assert(hash_blob_keyed(message, 0, key) == 0x726fdb47dd0e0e31);
+    assert(hash_blob_keyed(message, 1, key) == 0x74f839c593dc67fd);
+    assert(hash_blob_keyed(message, 15, key) == 0xa129ca6149be45e5);
+    assert(hash_blob_keyed(message, 63, key) == 0x958a324ceb064572);
+    assert(hash_string_keyed("abc", key) == hash_blob_keyed("abc", 3, key));
+
+    assert(hash_seed() != 0);
+    assert(hash_seed() == hash_seed());
+    assert(hash_string_fast("abc") == hash_blob_seeded("abc", 3, hash_seed()));
+    assert(hash_blob_fast("abc", 3) == hash_string_seeded("abc", hash_seed()));
+    for (i = 0; i <= 64; i++) {
+        uint64_t hash = hash_blob_seeded(message, i, 1);
+        assert(hash != hash_blob_seeded(message, i, 2));
+        assert(i == 0 || hash != hash_blob_seeded(message + 1, i - 1, 1));
+        uint8_t copy[65];
+        memcpy(copy + 1, message, i);
+        assert(hash == hash_blob_seeded(copy + 1, i, 1));
+        if (i > 0) {
+            copy[i] ^= 1;
+            assert(hash != hash_blob_seeded(copy + 1, i, 1));
+        }
+    }
+}
+
+int main()
+{
+    prepare_data();
+    hash_table_t *table = enter_data();
+    verify_contents(table);
+    test_replace(table);
+    verify_contents(table);
+    remove_elements(table);
+    verify_contents(table);
+    reenter_elements(table);
+    verify_contents(table);
+    detach_while_traversing(table);
+    verify_contents(table);
+    reenter_elements(table);
+    verify_contents(table);
+    drain(table);
+    verify_contents(table);
+    reenter_elements(table);
+    destroy_hash_table(table);
+    table = enter_data();
+    destroy_incrementally(table);
+    test_load_factor();
+    test_tombstones();
+    test_hashed();
+    test_strings();
+    test_hash_functions();
+    return EXIT_SUCCESS;
+}
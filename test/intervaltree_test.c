@@ -0,0 +1,179 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <fsdyn/intervaltree.h>
+
+enum {
+    RANGE = 1000,
+    N = 3000,
+    ROUNDS = 500,
+};
+
+static unsigned points[RANGE + 1];
+
+static int context;
+
+static int pointcmp(const void *point1, const void *point2, void *obj)
+{
+    assert(obj == &context);
+    unsigned p1 = *(const unsigned *) point1, p2 = *(const unsigned *) point2;
+    return p1 < p2 ? -1 : p1 > p2;
+}
+
+typedef struct {
+    unsigned low, high;
+    interval_elem_t *element;
+    unsigned seen;
+} interval_t;
+
+static interval_t intervals[N];
+static unsigned stamp;
+
+static void add_interval(interval_tree_t *tree, interval_t *interval)
+{
+    unsigned a = rand() % RANGE, b = a + rand() % (RANGE / 10);
+    if (b > RANGE)
+        b = RANGE;
+    interval->low = a;
+    interval->high = b;
+    interval->element =
+        interval_tree_add(tree, &points[a], &points[b], interval);
+}
+
+typedef struct {
+    unsigned low, high;
+    const void *previous_low;
+} query_t;
+
+static void check_overlap(interval_elem_t *element, void *arg)
+{
+    query_t *query = arg;
+    interval_t *interval = (interval_t *) interval_elem_get_value(element);
+    assert(interval->element == element);
+    assert(interval->low <= query->high && interval->high >= query->low);
+    assert(interval->seen != stamp);
+    interval->seen = stamp;
+    const void *low = interval_elem_get_low(element);
+    assert(!query->previous_low ||
+           pointcmp(query->previous_low, low, &context) <= 0);
+    query->previous_low = low;
+}
+
+static size_t count_overlaps(unsigned low, unsigned high)
+{
+    size_t count = 0;
+    unsigned i;
+    for (i = 0; i < N; i++)
+        if (intervals[i].element && intervals[i].low <= high &&
+            intervals[i].high >= low)
+            count++;
+    return count;
+}
+
+static void verify_query(interval_tree_t *tree, unsigned low, unsigned high)
+{
+    query_t query = { low, high, NULL };
+    stamp++;
+    size_t count;
+    if (low == high)
+        count = interval_tree_stab(tree, &points[low], check_overlap, &query);
+    else
+        count = interval_tree_overlap(tree, &points[low], &points[high],
+                                      check_overlap, &query);
+    assert(count == count_overlaps(low, high));
+}
+
+typedef struct {
+    const unsigned *probes;
+    size_t previous_index;
+    size_t count;
+} batch_t;
+
+static void check_stab(size_t index, interval_elem_t *element, void *arg)
+{
+    batch_t *batch = arg;
+    interval_t *interval = (interval_t *) interval_elem_get_value(element);
+    assert(index >= batch->previous_index);
+    batch->previous_index = index;
+    unsigned point = batch->probes[index];
+    assert(interval->low <= point && point <= interval->high);
+    batch->count++;
+}
+
+static void verify_batch(interval_tree_t *tree, size_t n)
+{
+    unsigned probes[n];
+    const void *probe_points[n];
+    size_t expected = 0, i;
+    unsigned point = rand() % RANGE;
+    for (i = 0; i < n; i++) {
+        probes[i] = point;
+        probe_points[i] = &points[point];
+        expected += count_overlaps(point, point);
+        point += rand() % 3;
+        if (point > RANGE)
+            point = RANGE;
+    }
+    batch_t batch = { probes, 0, 0 };
+    assert(interval_tree_stab_sorted(tree, probe_points, n, check_stab,
+                                     &batch) == expected);
+    assert(batch.count == expected);
+}
+
+static void verify_order(interval_tree_t *tree)
+{
+    size_t count = 0;
+    interval_elem_t *element, *previous = NULL;
+    for (element = interval_tree_get_first(tree); element;
+         element = interval_tree_next(element)) {
+        if (previous)
+            assert(pointcmp(interval_elem_get_low(previous),
+                            interval_elem_get_low(element), &context) <= 0);
+        assert(pointcmp(interval_elem_get_low(element),
+                        interval_elem_get_high(element), &context) <= 0);
+        previous = element;
+        count++;
+    }
+    assert(count == interval_tree_size(tree));
+}
+
+int main()
+{
+    unsigned i;
+    for (i = 0; i <= RANGE; i++)
+        points[i] = i;
+    interval_tree_t *tree = make_interval_tree_2(pointcmp, &context);
+    assert(interval_tree_empty(tree));
+    assert(interval_tree_stab_sorted(tree, NULL, 0, check_stab, NULL) == 0);
+    for (i = 0; i < N; i++)
+        add_interval(tree, &intervals[i]);
+    assert(interval_tree_size(tree) == N);
+    verify_order(tree);
+    for (i = 0; i < ROUNDS; i++) {
+        interval_t *interval = &intervals[rand() % N];
+        if (interval->element) {
+            interval_tree_remove(tree, interval->element);
+            interval->element = NULL;
+        } else
+            add_interval(tree, interval);
+        unsigned low = rand() % RANGE, high = low + rand() % 20;
+        verify_query(tree, low, low);
+        verify_query(tree, low, high > RANGE ? RANGE : high);
+        if (i % 50 == 0) {
+            verify_order(tree);
+            verify_batch(tree, 1 + rand() % 200);
+        }
+    }
+    for (i = 0; i < N; i++)
+        if (intervals[i].element && i % 2) {
+            interval_tree_remove(tree, intervals[i].element);
+            intervals[i].element = NULL;
+        }
+    verify_order(tree);
+    for (i = 0; i <= RANGE; i += 10)
+        verify_query(tree, i, i);
+    verify_batch(tree, 500);
+    destroy_interval_tree(tree);
+    return EXIT_SUCCESS;
+}
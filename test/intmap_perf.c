@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <fsdyn/hashtable.h>
+#include <fsdyn/integer.h>
+#include <fsdyn/intmap.h>
+
+enum {
+    KEYS = 1000000,
+};
+
+static uint64_t keys[KEYS], misses[KEYS];
+
+uint64_t now_ns()
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_usec * 1000;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static uint64_t hash_key(const void *key)
+{
+    return hash_unsigned((unsigned_t *) key);
+}
+
+static void report(const char *what, uint64_t start, uint64_t finish)
+{
+    fprintf(stderr, "%-24s %6.1f ns/op\n", what,
+            (double) (finish - start) / KEYS);
+}
+
+static void measure_intmap(void)
+{
+    uint64_t t0 = now_ns();
+    intmap_t *map = make_intmap(0);
+    int i;
+    for (i = 0; i < KEYS; i++)
+        intmap_put(map, keys[i], &keys[i], NULL);
+    uint64_t t1 = now_ns();
+    size_t found = 0;
+    for (i = 0; i < KEYS; i++)
+        found += intmap_get(map, keys[i], NULL);
+    uint64_t t2 = now_ns();
+    for (i = 0; i < KEYS; i++)
+        found += intmap_get(map, misses[i], NULL);
+    uint64_t t3 = now_ns();
+    for (i = 0; i < KEYS; i++)
+        intmap_pop(map, keys[i], NULL);
+    uint64_t t4 = now_ns();
+    destroy_intmap(map);
+    report("intmap put", t0, t1);
+    report("intmap get (hit)", t1, t2);
+    report("intmap get (miss)", t2, t3);
+    report("intmap pop", t3, t4);
+    if (found != KEYS)
+        abort();
+}
+
+static void measure_hash_table(void)
+{
+    uint64_t t0 = now_ns();
+    hash_table_t *table = make_hash_table(0, hash_key, unsigned_cmp);
+    int i;
+    for (i = 0; i < KEYS; i++)
+        hash_table_put(table, as_unsigned(keys[i]), &keys[i]);
+    uint64_t t1 = now_ns();
+    size_t found = 0;
+    for (i = 0; i < KEYS; i++)
+        found += hash_table_get(table, as_unsigned(keys[i])) != NULL;
+    uint64_t t2 = now_ns();
+    for (i = 0; i < KEYS; i++)
+        found += hash_table_get(table, as_unsigned(misses[i])) != NULL;
+    uint64_t t3 = now_ns();
+    for (i = 0; i < KEYS; i++)
+        destroy_hash_element(hash_table_pop(table, as_unsigned(keys[i])));
+    uint64_t t4 = now_ns();
+    destroy_hash_table(table);
+    report("hash_table put", t0, t1);
+    report("hash_table get (hit)", t1, t2);
+    report("hash_table get (miss)", t2, t3);
+    report("hash_table pop", t3, t4);
+    if (found != KEYS)
+        abort();
+}
+
+int main()
+{
+    fprintf(stderr, "prepare_data\n");
+    /* Random keys are odd and misses even so the sets are disjoint. */
+    uint64_t state = 1;
+    int i;
+    for (i = 0; i < KEYS; i++) {
+        keys[i] = (uintptr_t) next_random(&state) | 1;
+        misses[i] = (uintptr_t) next_random(&state) & ~(uint64_t) 1;
+    }
+    fprintf(stderr, "random keys\n");
+    measure_intmap();
+    measure_hash_table();
+    for (i = 0; i < KEYS; i++) {
+        keys[i] = i;
+        misses[i] = KEYS + i;
+    }
+    fprintf(stderr, "sequential keys\n");
+    measure_intmap();
+    measure_hash_table();
+    return EXIT_SUCCESS;
+}
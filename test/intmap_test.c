@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/intmap.h>
+
+enum {
+    N = 100000,
+};
+
+static uint64_t keys[N];
+static bool seen[N];
+
+static void test_basic(void)
+{
+    intmap_t *map = make_intmap(0);
+    assert(intmap_empty(map));
+    size_t i;
+    for (i = 0; i < N; i++) {
+        /* Include 0 and keys that differ only in their high bits. */
+        keys[i] = (uint64_t) i << (i % 2 ? 40 : 0);
+        assert(!intmap_put(map, keys[i], &keys[i], NULL));
+    }
+    assert(intmap_size(map) == N);
+    for (i = 0; i < N; i++) {
+        const void *value;
+        assert(intmap_get(map, keys[i], &value));
+        assert(value == &keys[i]);
+    }
+    assert(!intmap_get(map, N, NULL));
+    const void *old_value;
+    assert(intmap_put(map, 0, &keys[1], &old_value));
+    assert(old_value == &keys[0]);
+    assert(intmap_put(map, keys[3], &keys[4], &old_value));
+    assert(old_value == &keys[3]);
+    assert(intmap_size(map) == N);
+    for (i = 0; i < N; i += 2) {
+        const void *value;
+        assert(intmap_pop(map, keys[i], &value));
+    }
+    assert(!intmap_pop(map, 0, NULL));
+    assert(intmap_size(map) == N / 2);
+    for (i = 0; i < N; i++)
+        assert(intmap_get(map, keys[i], NULL) == (i % 2 != 0));
+    destroy_intmap(map);
+}
+
+static void test_traversal(void)
+{
+    intmap_t *map = make_intmap(N);
+    size_t i;
+    for (i = 0; i < N; i++)
+        intmap_put(map, i, &keys[i], NULL);
+    size_t cursor = 0, count = 0;
+    uint64_t key;
+    const void *value;
+    while (intmap_next(map, &cursor, &key, &value)) {
+        assert(key < N && !seen[key]);
+        assert(value == &keys[key]);
+        seen[key] = true;
+        count++;
+    }
+    assert(count == N);
+    for (i = 0; i < N; i++)
+        assert(intmap_pop(map, i, NULL));
+    assert(intmap_empty(map));
+    cursor = 0;
+    assert(!intmap_next(map, &cursor, NULL, NULL));
+    destroy_intmap(map);
+}
+
+int main()
+{
+    test_basic();
+    test_traversal();
+    return EXIT_SUCCESS;
+}
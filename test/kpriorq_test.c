@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/keyed_priority_queue.h>
+#include <fsdyn/priority_queue.h>
+
+enum {
+    N = 5000,
+    ROUNDS = 200000,
+};
+
+typedef struct {
+    uint64_t key;
+    void *loc;  /* in the keyed priority queue */
+    void *rloc; /* in the reference priority queue */
+    bool queued;
+} entry_t;
+
+static entry_t entries[N];
+
+static int cmp(const void *value1, const void *value2)
+{
+    uint64_t k1 = ((const entry_t *) value1)->key;
+    uint64_t k2 = ((const entry_t *) value2)->key;
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+static void reloc(const void *value, void *loc)
+{
+    ((entry_t *) value)->loc = loc;
+}
+
+static void reference_reloc(const void *value, void *loc)
+{
+    ((entry_t *) value)->rloc = loc;
+}
+
+static uint64_t random_key(void)
+{
+    /* Make equal keys common. */
+    if (random() % 2)
+        return random() % 100;
+    return (uint64_t) random() << 32 ^ random();
+}
+
+/* Compare the keyed priority queue with a priority queue. Elements with
+ * equal keys may come out in a different order, so only the keys are
+ * compared. */
+static void test_random(void)
+{
+    kpriorq_t *kprq = make_keyed_priority_queue(reloc);
+    priorq_t *reference = make_priority_queue(cmp, reference_reloc);
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        assert(kpriorq_size(kprq) == priorq_size(reference));
+        assert(kpriorq_empty(kprq) == priorq_empty(reference));
+        entry_t *entry = &entries[random() % N];
+        uint64_t key;
+        switch (random() % 5) {
+            case 0:
+                if (entry->queued) {
+                    assert(kpriorq_remove(kprq, entry->loc) == entry);
+                    priorq_remove(reference, entry->rloc);
+                    entry->queued = false;
+                    break;
+                }
+                /* fall through */
+            case 1:
+                if (!entry->queued) {
+                    entry->key = random_key();
+                    kpriorq_enqueue(kprq, entry->key, entry);
+                    priorq_enqueue(reference, entry);
+                    entry->queued = true;
+                }
+                break;
+            case 2:
+                if (entry->queued) {
+                    entry->key = random_key();
+                    kpriorq_update(kprq, entry->loc, entry->key);
+                    priorq_update(reference, entry->rloc);
+                }
+                break;
+            default: {
+                const entry_t *expected = priorq_peek(reference);
+                const entry_t *first = kpriorq_peek(kprq, &key);
+                if (!expected) {
+                    assert(!first && !kpriorq_dequeue(kprq, NULL));
+                    break;
+                }
+                assert(first->key == key && key == expected->key);
+                assert(kpriorq_dequeue(kprq, &key) == first);
+                assert(key == expected->key);
+                ((entry_t *) first)->queued = false;
+                priorq_remove(reference, first->rloc);
+            }
+        }
+    }
+    const entry_t *entry;
+    while ((entry = kpriorq_pop(kprq, NULL)) != NULL)
+        ((entry_t *) entry)->queued = false;
+    assert(!kpriorq_dequeue(kprq, NULL) && !kpriorq_peek(kprq, NULL));
+    kpriorq_enqueue(kprq, 1, &entries[0]);
+    destroy_keyed_priority_queue(kprq);
+    destroy_priority_queue(reference);
+}
+
+int main()
+{
+    test_random();
+    return EXIT_SUCCESS;
+}
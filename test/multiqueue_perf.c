@@ -0,0 +1,127 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <fsdyn/multiqueue.h>
+#include <fsdyn/priority_queue.h>
+
+enum {
+    ITEMS = 1000000,
+    OPERATIONS = 2000000, /* per thread */
+    MAX_THREADS = 256,
+    QUEUES_PER_THREAD = 2,
+};
+
+typedef struct {
+    uint64_t key;
+} item_t;
+
+static item_t mq_items[ITEMS], prq_items[ITEMS];
+static multiqueue_t *mq;
+static priorq_t *prq;
+static pthread_mutex_t prq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int cmp(const void *value1, const void *value2)
+{
+    uint64_t k1 = ((const item_t *) value1)->key;
+    uint64_t k2 = ((const item_t *) value2)->key;
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+uint64_t now_ns()
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_usec * 1000;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Each operation takes a work item and reschedules it a random
+ * distance later, as a dispatcher would. */
+static void *run_multiqueue(void *arg)
+{
+    uint64_t state = (uintptr_t) arg * 7919 + 1;
+    int i;
+    for (i = 0; i < OPERATIONS; i++) {
+        item_t *item = (item_t *) multiqueue_dequeue(mq);
+        item->key += next_random(&state) % ITEMS;
+        multiqueue_enqueue(mq, item);
+    }
+    return NULL;
+}
+
+static void *run_locked(void *arg)
+{
+    uint64_t state = (uintptr_t) arg * 7919 + 1;
+    int i;
+    for (i = 0; i < OPERATIONS; i++) {
+        pthread_mutex_lock(&prq_lock);
+        item_t *item = (item_t *) priorq_dequeue(prq);
+        pthread_mutex_unlock(&prq_lock);
+        item->key += next_random(&state) % ITEMS;
+        pthread_mutex_lock(&prq_lock);
+        priorq_enqueue(prq, item);
+        pthread_mutex_unlock(&prq_lock);
+    }
+    return NULL;
+}
+
+static double measure(void *(*run)(void *), int threads)
+{
+    pthread_t ids[MAX_THREADS];
+    uint64_t start = now_ns();
+    int i;
+    for (i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, run, (void *) (uintptr_t) i);
+    for (i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+    uint64_t finish = now_ns();
+    return (double) threads * OPERATIONS * 1000 / (finish - start);
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+    if (max_threads > MAX_THREADS)
+        max_threads = MAX_THREADS;
+    fprintf(stderr, "prepare_data\n");
+    mq = make_multiqueue(QUEUES_PER_THREAD * max_threads, cmp);
+    prq = make_priority_queue(cmp, NULL);
+    uint64_t state = 1;
+    int k;
+    for (k = 0; k < ITEMS; k++) {
+        mq_items[k].key = prq_items[k].key = next_random(&state) % ITEMS;
+        multiqueue_enqueue(mq, &mq_items[k]);
+        priorq_enqueue(prq, &prq_items[k]);
+    }
+    fprintf(stderr, "dequeue+enqueue pairs, Mops/s (speedup over 1 thread)\n");
+    fprintf(stderr, "threads   multiqueue       mutex+priorq\n");
+    double mq_base = 0, locked_base = 0;
+    int threads;
+    for (threads = 1; threads <= max_threads; threads++) {
+        double mq_rate = measure(run_multiqueue, threads);
+        double locked_rate = measure(run_locked, threads);
+        if (threads == 1) {
+            mq_base = mq_rate;
+            locked_base = locked_rate;
+        }
+        fprintf(stderr, "%7d %8.2f (%5.2fx) %8.2f (%5.2fx)\n", threads,
+                mq_rate, mq_rate / mq_base, locked_rate,
+                locked_rate / locked_base);
+    }
+    destroy_multiqueue(mq);
+    destroy_priority_queue(prq);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/multiqueue.h>
+
+enum {
+    N = 100000,
+    QUEUES = 8,
+    THREADS = 4,
+};
+
+static uintptr_t values[N];
+static unsigned seen[N];
+
+static int cmp(const void *value1, const void *value2)
+{
+    uintptr_t v1 = *(const uintptr_t *) value1;
+    uintptr_t v2 = *(const uintptr_t *) value2;
+    return v1 < v2 ? -1 : v1 > v2;
+}
+
+/* Every element comes out once, and close to the priority order. */
+static void test_basic(void)
+{
+    multiqueue_t *mq = make_multiqueue(QUEUES, cmp);
+    assert(multiqueue_empty(mq) && !multiqueue_dequeue(mq));
+    uintptr_t i;
+    for (i = 0; i < N; i++)
+        values[i] = i;
+    for (i = N - 1; i > 0; i--) {
+        uintptr_t j = random() % (i + 1);
+        uintptr_t value = values[i];
+        values[i] = values[j];
+        values[j] = value;
+    }
+    for (i = 0; i < N; i++)
+        multiqueue_enqueue(mq, &values[i]);
+    assert(multiqueue_size(mq) == N && !multiqueue_empty(mq));
+    uint64_t distance = 0;
+    for (i = 0; i < N; i++) {
+        const uintptr_t *value = multiqueue_dequeue(mq);
+        assert(value && !seen[*value]++);
+        distance += *value > i ? *value - i : i - *value;
+    }
+    assert(distance / N < 4 * QUEUES);
+    assert(multiqueue_empty(mq) && !multiqueue_dequeue(mq));
+    multiqueue_enqueue(mq, &values[0]);
+    assert(multiqueue_size(mq) == 1);
+    destroy_multiqueue(mq);
+}
+
+static multiqueue_t *shared;
+
+/* Every thread enqueues its share of the values and dequeues as many
+ * elements, which need not be its own. */
+static void *churn(void *arg)
+{
+    uintptr_t i;
+    for (i = (uintptr_t) arg; i < N; i += THREADS) {
+        multiqueue_enqueue(shared, &values[i]);
+        if (i % 3 == 0)
+            continue;
+        const uintptr_t *value;
+        while (!(value = multiqueue_dequeue(shared)))
+            ;
+        __atomic_add_fetch(&seen[*value], 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void test_concurrency(void)
+{
+    shared = make_multiqueue(2 * THREADS, cmp);
+    uintptr_t i;
+    for (i = 0; i < N; i++) {
+        values[i] = i;
+        seen[i] = 0;
+    }
+    pthread_t threads[THREADS];
+    for (i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, churn, (void *) i);
+    for (i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    const uintptr_t *value;
+    while ((value = multiqueue_dequeue(shared)) != NULL)
+        seen[*value]++;
+    assert(multiqueue_empty(shared));
+    for (i = 0; i < N; i++)
+        assert(seen[i] == 1);
+    destroy_multiqueue(shared);
+}
+
+int main()
+{
+    test_basic();
+    test_concurrency();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fsdyn/pavltree.h>
+
+enum {
+    N = 2000,
+    GENERATIONS = 20,
+    OPERATIONS = 1000,
+    READERS = 8,
+};
+
+static unsigned keys[N];
+
+static int context;
+
+static int keycmp(const void *key1, const void *key2, void *obj)
+{
+    assert(obj == &context);
+    unsigned k1 = *(const unsigned *) key1, k2 = *(const unsigned *) key2;
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+/* A model of a tree: the value of keys[i] is model[i], or the key is
+ * absent if model[i] is 0. */
+typedef struct {
+    uintptr_t values[N];
+    size_t size;
+} model_t;
+
+typedef struct {
+    const model_t *model;
+    unsigned next;
+} cursor_t;
+
+static bool check_element(const void *key, const void *value, void *arg)
+{
+    cursor_t *cursor = arg;
+    unsigned k = *(const unsigned *) key;
+    assert(key == &keys[k]);
+    for (; cursor->next < k; cursor->next++)
+        assert(!cursor->model->values[cursor->next]);
+    assert(k == cursor->next);
+    assert((uintptr_t) value == cursor->model->values[k]);
+    cursor->next++;
+    return true;
+}
+
+static bool stop_early(const void *key, const void *value, void *arg)
+{
+    return --*(int *) arg > 0;
+}
+
+static void verify(pavl_tree_t *tree, const model_t *model)
+{
+    assert(pavl_tree_size(tree) == model->size);
+    assert(!pavl_tree_empty(tree) == !!model->size);
+    cursor_t cursor = { model, 0 };
+    assert(pavl_tree_foreach(tree, check_element, &cursor));
+    for (; cursor.next < N; cursor.next++)
+        assert(!model->values[cursor.next]);
+    unsigned i;
+    for (i = 0; i < N; i++) {
+        const void *value;
+        if (model->values[i]) {
+            assert(pavl_tree_get(tree, &keys[i], &value));
+            assert((uintptr_t) value == model->values[i]);
+        } else
+            assert(!pavl_tree_get(tree, &keys[i], NULL));
+    }
+    if (model->size > 1) {
+        int count = 2;
+        assert(!pavl_tree_foreach(tree, stop_early, &count));
+        assert(count == 0);
+    }
+}
+
+static void modify(pavl_tree_t *tree, model_t *model, unsigned operations)
+{
+    while (operations--) {
+        unsigned k = rand() % N;
+        const void *key, *value;
+        if (rand() % 3) {
+            uintptr_t v = rand() + 1;
+            bool found =
+                pavl_tree_put(tree, &keys[k], (void *) v, &key, &value);
+            assert(found == !!model->values[k]);
+            if (found) {
+                assert(key == &keys[k]);
+                assert((uintptr_t) value == model->values[k]);
+            } else
+                model->size++;
+            model->values[k] = v;
+        } else if (pavl_tree_pop(tree, &keys[k], &key, &value)) {
+            assert(key == &keys[k]);
+            assert((uintptr_t) value == model->values[k]);
+            model->values[k] = 0;
+            model->size--;
+        } else
+            assert(!model->values[k]);
+    }
+}
+
+static void test_snapshots(void)
+{
+    static model_t models[GENERATIONS + 1];
+    pavl_tree_t *snapshots[GENERATIONS + 1];
+    pavl_tree_t *tree = make_pavl_tree_2(keycmp, &context);
+    model_t *model = &models[GENERATIONS];
+    verify(tree, model);
+    unsigned g;
+    for (g = 0; g < GENERATIONS; g++) {
+        snapshots[g] = pavl_tree_snapshot(tree);
+        models[g] = *model;
+        modify(tree, model, OPERATIONS);
+        verify(tree, model);
+    }
+    snapshots[GENERATIONS] = tree;
+    for (g = 0; g <= GENERATIONS; g++)
+        verify(snapshots[g], &models[g]);
+
+    /* A snapshot can be modified independently of the original. */
+    modify(snapshots[0], &models[0], OPERATIONS);
+    for (g = 0; g <= GENERATIONS; g++)
+        verify(snapshots[g], &models[g]);
+
+    /* Destroy the trees in an arbitrary order. */
+    unsigned remaining = GENERATIONS + 1;
+    while (remaining) {
+        unsigned i = rand() % remaining--;
+        destroy_pavl_tree(snapshots[i]);
+        snapshots[i] = snapshots[remaining];
+        models[i] = models[remaining];
+        for (g = 0; g < remaining; g++)
+            verify(snapshots[g], &models[g]);
+    }
+}
+
+typedef struct {
+    pavl_tree_t *tree;
+    model_t model;
+} reader_t;
+
+static void *read_snapshot(void *arg)
+{
+    reader_t *reader = arg;
+    verify(reader->tree, &reader->model);
+    destroy_pavl_tree(reader->tree);
+    return NULL;
+}
+
+static void test_concurrency(void)
+{
+    static reader_t readers[READERS];
+    pthread_t threads[READERS];
+    pavl_tree_t *tree = make_pavl_tree_2(keycmp, &context);
+    model_t model;
+    memset(&model, 0, sizeof model);
+    modify(tree, &model, N);
+    unsigned i;
+    for (i = 0; i < READERS; i++) {
+        readers[i].tree = pavl_tree_snapshot(tree);
+        readers[i].model = model;
+        pthread_create(&threads[i], NULL, read_snapshot, &readers[i]);
+        modify(tree, &model, OPERATIONS);
+    }
+    for (i = 0; i < READERS; i++)
+        pthread_join(threads[i], NULL);
+    verify(tree, &model);
+    destroy_pavl_tree(tree);
+}
+
+int main()
+{
+    unsigned i;
+    for (i = 0; i < N; i++)
+        keys[i] = i;
+    test_snapshots();
+    test_concurrency();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fsdyn/hashtable.h>
+#include <fsdyn/phash.h>
+
+enum {
+    N = 100000,
+};
+
+static char path[] = "/tmp/phash_test.XXXXXX";
+
+static void make_key(char *buf, size_t size, unsigned i)
+{
+    snprintf(buf, size, "key-%u", i);
+}
+
+static void test_array(void)
+{
+    phash_builder_t *builder = make_phash_builder();
+    unsigned i;
+    for (i = 0; i < N; i++) {
+        char key[32];
+        make_key(key, sizeof key, i);
+        uint64_t value = (uint64_t) i * i;
+        /* Values of varying size test the padding. */
+        phash_builder_add(builder, key, strlen(key), &value,
+                          sizeof value - i % 8);
+    }
+    assert(phash_builder_write(builder, path));
+    destroy_phash_builder(builder);
+    phash_t *phash = open_phash(path);
+    assert(phash);
+    assert(phash_size(phash) == N);
+    for (i = 0; i < N; i++) {
+        char key[32];
+        make_key(key, sizeof key, i);
+        const void *value;
+        size_t value_size;
+        assert(phash_get(phash, key, strlen(key), &value, &value_size));
+        assert(value_size == sizeof(uint64_t) - i % 8);
+        assert((uintptr_t) value % 8 == 0);
+        uint64_t expected = (uint64_t) i * i;
+        assert(memcmp(value, &expected, value_size) == 0);
+    }
+    for (i = N; i < 2 * N; i++) {
+        char key[32];
+        make_key(key, sizeof key, i);
+        assert(!phash_get(phash, key, strlen(key), NULL, NULL));
+    }
+    assert(!phash_get(phash, "", 0, NULL, NULL));
+    close_phash(phash);
+}
+
+static void encode(void *obj, phash_builder_t *builder, const void *key,
+                   const void *value)
+{
+    (*(int *) obj)++;
+    phash_builder_add(builder, key, strlen(key), value, strlen(value) + 1);
+}
+
+static void test_hash_table(void)
+{
+    static const char *words[][2] = {
+        { "one", "yksi" },   { "two", "kaksi" }, { "three", "kolme" },
+        { "four", "neljä" }, { "five", "viisi" }, { "", "nolla" },
+    };
+    hash_table_t *table = make_hash_table(0, (void *) hash_string,
+                                          (void *) strcmp);
+    size_t i, n = sizeof words / sizeof words[0];
+    for (i = 0; i < n; i++)
+        hash_table_put(table, words[i][0], words[i][1]);
+    phash_builder_t *builder = make_phash_builder();
+    int count = 0;
+    phash_builder_add_hash_table(builder, table, encode, &count);
+    assert(count == n);
+    assert(phash_builder_write(builder, path));
+    destroy_phash_builder(builder);
+    destroy_hash_table(table);
+    phash_t *phash = open_phash(path);
+    assert(phash && phash_size(phash) == n);
+    for (i = 0; i < n; i++) {
+        const void *value;
+        assert(phash_get(phash, words[i][0], strlen(words[i][0]), &value,
+                         NULL));
+        assert(!strcmp(value, words[i][1]));
+    }
+    assert(!phash_get(phash, "six", 3, NULL, NULL));
+    close_phash(phash);
+}
+
+/* Replace an image that is open. */
+static void test_replace(void)
+{
+    phash_builder_t *builder = make_phash_builder();
+    phash_builder_add(builder, "a", 1, "1", 1);
+    assert(phash_builder_write(builder, path));
+    destroy_phash_builder(builder);
+    phash_t *old = open_phash(path);
+    assert(old);
+    builder = make_phash_builder();
+    phash_builder_add(builder, "b", 1, "22", 2);
+    assert(phash_builder_write(builder, path));
+    destroy_phash_builder(builder);
+    const void *value;
+    size_t value_size;
+    assert(phash_get(old, "a", 1, &value, &value_size));
+    assert(value_size == 1 && memcmp(value, "1", 1) == 0);
+    phash_t *phash = open_phash(path);
+    assert(phash);
+    assert(!phash_get(phash, "a", 1, NULL, NULL));
+    assert(phash_get(phash, "b", 1, &value, &value_size));
+    assert(value_size == 2 && memcmp(value, "22", 2) == 0);
+    close_phash(phash);
+    close_phash(old);
+}
+
+static void test_errors(void)
+{
+    phash_builder_t *builder = make_phash_builder();
+    assert(phash_builder_write(builder, path));
+    phash_t *phash = open_phash(path);
+    assert(phash && phash_size(phash) == 0);
+    assert(!phash_get(phash, "x", 1, NULL, NULL));
+    close_phash(phash);
+    phash_builder_add(builder, "x", 1, "1", 1);
+    phash_builder_add(builder, "y", 1, "2", 1);
+    phash_builder_add(builder, "x", 1, "3", 1);
+    errno = 0;
+    assert(!phash_builder_write(builder, path));
+    assert(errno == EEXIST);
+    destroy_phash_builder(builder);
+    FILE *f = fopen(path, "w");
+    fputs("not a perfect hash image, not at all", f);
+    fclose(f);
+    errno = 0;
+    assert(!open_phash(path));
+    assert(errno == EINVAL);
+    assert(!open_phash("/nonexistent/phash"));
+    assert(errno == ENOENT);
+    builder = make_phash_builder();
+    errno = 0;
+    assert(!phash_builder_write(builder, "/nonexistent/phash"));
+    assert(errno == ENOENT);
+    destroy_phash_builder(builder);
+}
+
+int main()
+{
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    test_array();
+    test_hash_table();
+    test_replace();
+    test_errors();
+    unlink(path);
+    return EXIT_SUCCESS;
+}
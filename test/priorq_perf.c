@@ -6,6 +6,8 @@
 #include <sys/time.h>
 
 #include <fsdyn/avltree.h>
+#include <fsdyn/btree.h>
+#include <fsdyn/keyed_priority_queue.h>
 #include <fsdyn/priority_queue.h>
 
 enum {
@@ -49,6 +51,53 @@ static avl_tree_t *enter_avl_data()
     return tree;
 }
 
+static btree_t *enter_btree_data()
+{
+    btree_t *tree = make_btree(cmp);
+    int i;
+    for (i = 0; i < N; i++)
+        btree_put(tree, &elements[i], &elements[i], NULL, NULL);
+    return tree;
+}
+
+static int cmp_2(const void *value1, const void *value2, void *obj)
+{
+    return cmp(value1, value2);
+}
+
+static void reloc_2(const void *value, void *loc, void *obj)
+{
+    reloc(value, loc);
+}
+
+static priorq_t *enter_d_ary_pr_data(size_t arity)
+{
+    priorq_t *prq = make_d_ary_priority_queue(cmp_2, reloc_2, NULL, arity);
+    int i;
+    for (i = 0; i < N; i++)
+        priorq_enqueue(prq, &elements[i]);
+    return prq;
+}
+
+/* The first eight bytes of the key as a number. */
+static uint64_t key_prefix(const element_t *element)
+{
+    uint64_t prefix = 0;
+    int i;
+    for (i = 0; i < 8; i++)
+        prefix = prefix << 8 | element->key[i];
+    return prefix;
+}
+
+static kpriorq_t *enter_kpr_data(void (*reloc)(const void *, void *))
+{
+    kpriorq_t *kprq = make_keyed_priority_queue(reloc);
+    int i;
+    for (i = 0; i < N; i++)
+        kpriorq_enqueue(kprq, key_prefix(&elements[i]), &elements[i]);
+    return kprq;
+}
+
 static priorq_t *enter_pr_data()
 {
     priorq_t *prq = make_priority_queue(cmp, reloc);
@@ -76,6 +125,15 @@ static void test_performance()
     destroy_avl_tree(tree);
     uint64_t finish = now_ns();
     fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    fprintf(stderr, "measure B-tree\n");
+    start = now_ns();
+    btree_t *btree = enter_btree_data();
+    btree_elem_t *be = btree_get_first(btree);
+    while (be)
+        be = btree_next(be);
+    destroy_btree(btree);
+    finish = now_ns();
+    fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
     fprintf(stderr, "measure priority queue dequeue\n");
     start = now_ns();
     priorq_t *prq = enter_pr_data();
@@ -84,6 +142,22 @@ static void test_performance()
     destroy_priority_queue(prq);
     finish = now_ns();
     fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    fprintf(stderr, "measure keyed priority queue dequeue\n");
+    start = now_ns();
+    kpriorq_t *kprq = enter_kpr_data(reloc);
+    while (!kpriorq_empty(kprq))
+        kpriorq_dequeue(kprq, NULL);
+    destroy_keyed_priority_queue(kprq);
+    finish = now_ns();
+    fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    fprintf(stderr, "measure keyed priority queue dequeue without reloc\n");
+    start = now_ns();
+    kprq = enter_kpr_data(NULL);
+    while (!kpriorq_empty(kprq))
+        kpriorq_dequeue(kprq, NULL);
+    destroy_keyed_priority_queue(kprq);
+    finish = now_ns();
+    fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
     fprintf(stderr, "measure priority queue remove\n");
     start = now_ns();
     prq = enter_pr_data();
@@ -93,6 +167,55 @@ static void test_performance()
     destroy_priority_queue(prq);
     finish = now_ns();
     fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    size_t arity;
+    for (arity = 2; arity <= 16; arity *= 2) {
+        fprintf(stderr, "measure %zu-ary priority queue\n", arity);
+        start = now_ns();
+        prq = enter_d_ary_pr_data(arity);
+        uint64_t middle = now_ns();
+        while (!priorq_empty(prq))
+            priorq_dequeue(prq);
+        destroy_priority_queue(prq);
+        finish = now_ns();
+        fprintf(stderr, "  enqueue %g s, dequeue %g s\n",
+                (middle - start) * 1e-9, (finish - middle) * 1e-9);
+    }
+    static const void *values[N];
+    for (i = 0; i < N; i++)
+        values[i] = &elements[i];
+    for (arity = 2; arity <= 4; arity *= 2) {
+        fprintf(stderr, "measure %zu-ary priority queue enqueue_array\n",
+                arity);
+        start = now_ns();
+        prq = make_d_ary_priority_queue(cmp_2, reloc_2, NULL, arity);
+        priorq_enqueue_array(prq, values, N);
+        finish = now_ns();
+        destroy_priority_queue(prq);
+        fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    }
+    fprintf(stderr, "measure priority queue update\n");
+    prq = enter_pr_data();
+    start = now_ns();
+    for (i = 0; i < N; i++) {
+        element_t *e = &elements[random() % N];
+        e->key[0] = random() % 256;
+        priorq_update(prq, e->loc);
+    }
+    finish = now_ns();
+    destroy_priority_queue(prq);
+    fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
+    fprintf(stderr, "measure priority queue remove and enqueue\n");
+    prq = enter_pr_data();
+    start = now_ns();
+    for (i = 0; i < N; i++) {
+        element_t *e = &elements[random() % N];
+        priorq_remove(prq, e->loc);
+        e->key[0] = random() % 256;
+        priorq_enqueue(prq, e);
+    }
+    finish = now_ns();
+    destroy_priority_queue(prq);
+    fprintf(stderr, "  %g s\n", (finish - start) * 1e-9);
 }
 
 int main()
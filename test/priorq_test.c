@@ -58,12 +58,104 @@ static priorq_t *enter_pr_data()
     return prq;
 }
 
-static bool test_correctness()
+static int cmp_2(const void *value1, const void *value2, void *obj)
 {
-    fprintf(stderr, "enter_data\n");
+    return cmp(value1, value2);
+}
+
+static void reloc_2(const void *value, void *loc, void *obj)
+{
+    reloc(value, loc);
+}
+
+static priorq_t *enter_d_ary_pr_data(size_t arity)
+{
+    priorq_t *prq = make_d_ary_priority_queue(cmp_2, reloc_2, NULL, arity);
+    int i;
+    for (i = 0; i < N; i++)
+        priorq_enqueue(prq, &elements[i]);
+    return prq;
+}
+
+static bool test_correctness(size_t arity)
+{
+    fprintf(stderr, "enter_data (arity %zu)\n", arity);
+    avl_tree_t *tree = enter_avl_data();
+    avl_elem_t *ae = avl_tree_get_first(tree);
+    priorq_t *prq = arity ? enter_d_ary_pr_data(arity) : enter_pr_data();
+    while (!priorq_empty(prq)) {
+        element_t *e = (element_t *) priorq_dequeue(prq);
+        if (e != avl_elem_get_value(ae)) {
+            fprintf(stderr, "Mismatch!\n");
+            return false;
+        }
+        ae = avl_tree_next(ae);
+    }
+    destroy_priority_queue(prq);
+    destroy_avl_tree(tree);
+    return true;
+}
+
+static const void *values[N];
+
+static void enter_array(priorq_t *prq, size_t begin, size_t end)
+{
+    priorq_enqueue_array(prq, values + begin, end - begin);
+}
+
+static bool test_enqueue_array(size_t arity)
+{
+    fprintf(stderr, "enqueue_array (arity %zu)\n", arity);
     avl_tree_t *tree = enter_avl_data();
+    priorq_t *prq = make_d_ary_priority_queue(cmp_2, reloc_2, NULL, arity);
+    int i;
+    for (i = 0; i < N; i++)
+        values[i] = &elements[i];
+    priorq_reserve(prq, N / 4);
+    enter_array(prq, 0, N / 4);
+    enter_array(prq, N / 4, N / 4 + 100);
+    enter_array(prq, N / 4 + 100, N);
+    priorq_enqueue_array(prq, NULL, 0);
+    if (priorq_size(prq) != N) {
+        fprintf(stderr, "Bad size!\n");
+        return false;
+    }
+    /* Check the locators. */
+    for (i = 0; i < N; i += 3) {
+        if (priorq_remove(prq, elements[i].loc) != &elements[i]) {
+            fprintf(stderr, "Bad locator!\n");
+            return false;
+        }
+        destroy_avl_element(avl_tree_pop(tree, &elements[i]));
+    }
+    avl_elem_t *ae = avl_tree_get_first(tree);
+    while (!priorq_empty(prq)) {
+        element_t *e = (element_t *) priorq_dequeue(prq);
+        if (e != avl_elem_get_value(ae)) {
+            fprintf(stderr, "Mismatch!\n");
+            return false;
+        }
+        ae = avl_tree_next(ae);
+    }
+    destroy_priority_queue(prq);
+    destroy_avl_tree(tree);
+    return true;
+}
+
+static bool test_update(size_t arity)
+{
+    fprintf(stderr, "update (arity %zu)\n", arity);
+    avl_tree_t *tree = enter_avl_data();
+    priorq_t *prq = enter_d_ary_pr_data(arity);
+    int round;
+    for (round = 0; round < N / 10; round++) {
+        element_t *e = &elements[random() % N];
+        destroy_avl_element(avl_tree_pop(tree, e));
+        e->key[random() % K] = random() % 256;
+        avl_tree_put(tree, e, e);
+        priorq_update(prq, e->loc);
+    }
     avl_elem_t *ae = avl_tree_get_first(tree);
-    priorq_t *prq = enter_pr_data();
     while (!priorq_empty(prq)) {
         element_t *e = (element_t *) priorq_dequeue(prq);
         if (e != avl_elem_get_value(ae)) {
@@ -81,7 +173,14 @@ int main()
 {
     fprintf(stderr, "prepare_data\n");
     prepare_data();
-    if (!test_correctness())
+    size_t arities[] = { 0, 1, 3, 4, 8 };
+    int i;
+    for (i = 0; i < sizeof arities / sizeof arities[0]; i++)
+        if (!test_correctness(arities[i]))
+            return EXIT_FAILURE;
+    if (!test_enqueue_array(2) || !test_enqueue_array(4))
+        return EXIT_FAILURE;
+    if (!test_update(2) || !test_update(4))
         return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/priority_queue.h>
+#include <fsdyn/radixheap.h>
+
+enum {
+    N = 10000,
+    ROUNDS = 200000,
+};
+
+typedef struct {
+    uint64_t key;
+} entry_t;
+
+static entry_t entries[N];
+
+static int cmp(const void *value1, const void *value2)
+{
+    uint64_t k1 = ((const entry_t *) value1)->key;
+    uint64_t k2 = ((const entry_t *) value2)->key;
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+static uint64_t random64(void)
+{
+    return (uint64_t) random() << 42 ^ (uint64_t) random() << 21 ^ random();
+}
+
+/* Mix keys close to and far from the key dequeued last. */
+static uint64_t random_key(uint64_t last)
+{
+    uint64_t delta;
+    switch (random() % 4) {
+        case 0:
+            delta = random() % 3;
+            break;
+        case 1:
+            delta = random() % 1000;
+            break;
+        default:
+            delta = random64() >> (random() % 64);
+    }
+    return delta > UINT64_MAX - last ? UINT64_MAX : last + delta;
+}
+
+/* Compare the radix heap with a priority queue. Elements with equal
+ * keys may come out in a different order, so only the keys are
+ * compared. */
+static void test_random(void)
+{
+    radix_heap_t *heap = make_radix_heap();
+    priorq_t *reference = make_priority_queue(cmp, NULL);
+    uint64_t last = 0, key;
+    size_t used = 0;
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        assert(radix_heap_size(heap) == priorq_size(reference));
+        assert(radix_heap_empty(heap) == priorq_empty(reference));
+        if (used < N && random() % 2) {
+            entry_t *entry = &entries[used++];
+            entry->key = random_key(last);
+            assert(radix_heap_enqueue(heap, entry->key, entry));
+            priorq_enqueue(reference, entry);
+            continue;
+        }
+        const entry_t *expected = priorq_peek(reference);
+        const entry_t *entry = radix_heap_peek(heap, &key);
+        if (!expected) {
+            assert(!entry);
+            assert(!radix_heap_dequeue(heap, NULL));
+            continue;
+        }
+        assert(entry->key == key && key == expected->key);
+        if (random() % 4 == 0)
+            continue;
+        assert(radix_heap_dequeue(heap, &key) == entry);
+        assert(key == expected->key);
+        priorq_dequeue(reference);
+        last = key;
+        if (last) {
+            errno = 0;
+            assert(!radix_heap_enqueue(heap, last - 1, NULL));
+            assert(errno == EINVAL);
+        }
+        if (used == N && priorq_empty(reference))
+            used = 0;
+    }
+    while (radix_heap_dequeue(heap, NULL))
+        ;
+    assert(radix_heap_empty(heap));
+    for (round = 0; round < 100; round++)
+        radix_heap_enqueue(heap, random_key(last), NULL);
+    destroy_radix_heap(heap);
+    destroy_priority_queue(reference);
+}
+
+int main()
+{
+    test_random();
+    return EXIT_SUCCESS;
+}
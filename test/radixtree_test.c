@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fsdyn/avltree.h>
+#include <fsdyn/radixtree.h>
+
+enum {
+    ROUNDS = 100000,
+    MAX_SIZE = 40,
+};
+
+/* The keys are allocated separately and freed as soon as they leave the
+ * tree so stale references to them are caught by memory checkers. */
+typedef struct {
+    size_t size;
+    uint8_t bytes[MAX_SIZE];
+} blob_t;
+
+static int keycmp(const void *key1, const void *key2)
+{
+    const blob_t *k1 = key1, *k2 = key2;
+    size_t size = k1->size < k2->size ? k1->size : k2->size;
+    int cmp = memcmp(k1->bytes, k2->bytes, size);
+    if (cmp)
+        return cmp;
+    return k1->size < k2->size ? -1 : k1->size > k2->size;
+}
+
+static const char *const stems[] = {
+    "",
+    "a",
+    "ab",
+    "www.example.com/",
+    "www.example.com/index.html",
+    "www.example.org/",
+    "\xff\xfe",
+};
+
+/* Make keys that share long prefixes, are prefixes of each other and
+ * branch on many byte values. */
+static void random_key(blob_t *key)
+{
+    const char *stem = stems[rand() % (sizeof stems / sizeof stems[0])];
+    key->size = strlen(stem);
+    memcpy(key->bytes, stem, key->size);
+    size_t suffix = rand() % 4;
+    while (suffix-- && key->size < MAX_SIZE)
+        key->bytes[key->size++] = rand() % 2 ? "abc"[rand() % 3] : rand();
+}
+
+static blob_t *copy_key(const blob_t *key)
+{
+    blob_t *copy = malloc(sizeof *copy);
+    *copy = *key;
+    return copy;
+}
+
+typedef struct {
+    avl_elem_t *expected;
+    const blob_t *prefix;
+    size_t count;
+} check_t;
+
+static bool has_prefix(const blob_t *key, const blob_t *prefix)
+{
+    return key->size >= prefix->size &&
+        !memcmp(key->bytes, prefix->bytes, prefix->size);
+}
+
+static void skip_to_prefix(check_t *check)
+{
+    while (check->expected &&
+           !has_prefix(avl_elem_get_key(check->expected), check->prefix))
+        check->expected = avl_tree_next(check->expected);
+}
+
+static bool check_next(const void *key, size_t size, const void *value,
+                       void *arg)
+{
+    check_t *check = arg;
+    skip_to_prefix(check);
+    assert(check->expected);
+    const blob_t *expected = avl_elem_get_key(check->expected);
+    assert(value == expected);
+    assert(key == expected->bytes);
+    assert(size == expected->size);
+    check->expected = avl_tree_next(check->expected);
+    check->count++;
+    return true;
+}
+
+static bool stop(const void *key, size_t size, const void *value, void *arg)
+{
+    ++*(int *) arg;
+    return false;
+}
+
+static void verify_scan(radix_tree_t *tree, avl_tree_t *reference,
+                        const blob_t *prefix)
+{
+    check_t check = { avl_tree_get_first(reference), prefix, 0 };
+    assert(radix_tree_scan_prefix(tree, prefix->bytes, prefix->size,
+                                  check_next, &check));
+    skip_to_prefix(&check);
+    assert(!check.expected);
+    int calls = 0;
+    bool completed =
+        radix_tree_scan_prefix(tree, prefix->bytes, prefix->size, stop,
+                               &calls);
+    assert(completed == !check.count && calls == !!check.count);
+}
+
+static void verify_longest_prefix(radix_tree_t *tree, avl_tree_t *reference,
+                                  const blob_t *key)
+{
+    const blob_t *expected = NULL;
+    avl_elem_t *element;
+    for (element = avl_tree_get_first(reference); element;
+         element = avl_tree_next(element))
+        if (has_prefix(key, avl_elem_get_key(element)))
+            expected = avl_elem_get_key(element);
+    const void *found_key, *value;
+    size_t size;
+    bool found = radix_tree_longest_prefix(tree, key->bytes, key->size,
+                                           &found_key, &size, &value);
+    assert(found == (expected != NULL));
+    if (found) {
+        assert(value == expected);
+        assert(found_key == expected->bytes && size == expected->size);
+    }
+}
+
+static void verify(radix_tree_t *tree, avl_tree_t *reference)
+{
+    assert(radix_tree_size(tree) == avl_tree_size(reference));
+    assert(radix_tree_empty(tree) == avl_tree_empty(reference));
+    blob_t empty = { 0 };
+    check_t check = { avl_tree_get_first(reference), &empty, 0 };
+    assert(radix_tree_foreach(tree, check_next, &check));
+    assert(!check.expected && check.count == avl_tree_size(reference));
+    verify_scan(tree, reference, &empty);
+    int i;
+    for (i = 0; i < 20; i++) {
+        blob_t key;
+        random_key(&key);
+        verify_scan(tree, reference, &key);
+        verify_longest_prefix(tree, reference, &key);
+    }
+}
+
+static void test_random(void)
+{
+    radix_tree_t *tree = make_radix_tree();
+    avl_tree_t *reference = make_avl_tree(keycmp);
+    verify(tree, reference);
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        blob_t key;
+        random_key(&key);
+        avl_elem_t *element = avl_tree_get(reference, &key);
+        const void *old_key, *old_value;
+        switch (rand() % 3) {
+            case 0:
+                if (element) {
+                    blob_t *k = (blob_t *) avl_elem_get_key(element);
+                    assert(radix_tree_pop(tree, key.bytes, key.size,
+                                          &old_key, &old_value));
+                    assert(old_key == k->bytes && old_value == k);
+                    avl_tree_remove(reference, element);
+                    free(k);
+                } else
+                    assert(!radix_tree_pop(tree, key.bytes, key.size, NULL,
+                                           NULL));
+                break;
+            case 1: {
+                blob_t *k = copy_key(&key);
+                bool replaced = radix_tree_put(tree, k->bytes, k->size, k,
+                                               &old_key, &old_value);
+                assert(replaced == (element != NULL));
+                avl_elem_t *old = avl_tree_put(reference, k, k);
+                if (old) {
+                    assert(old_value == avl_elem_get_key(old));
+                    free((blob_t *) avl_elem_get_key(old));
+                    destroy_avl_element(old);
+                }
+                break;
+            }
+            default: {
+                const void *value;
+                bool found = radix_tree_get(tree, key.bytes, key.size, &value);
+                assert(found == (element != NULL));
+                if (found)
+                    assert(value == avl_elem_get_key(element));
+            }
+        }
+        if (round % 1000 == 0)
+            verify(tree, reference);
+    }
+    verify(tree, reference);
+    while (!avl_tree_empty(reference)) {
+        avl_elem_t *element = avl_tree_pop_first(reference);
+        blob_t *k = (blob_t *) avl_elem_get_key(element);
+        assert(radix_tree_pop(tree, k->bytes, k->size, NULL, NULL));
+        free(k);
+        destroy_avl_element(element);
+        if (avl_tree_size(reference) % 100 == 0)
+            verify(tree, reference);
+    }
+    assert(radix_tree_empty(tree));
+    destroy_avl_tree(reference);
+    destroy_radix_tree(tree);
+}
+
+/* Grow and shrink one node through all node sizes. */
+static void test_fanout(void)
+{
+    static uint8_t bytes[256][2];
+    radix_tree_t *tree = make_radix_tree();
+    int i;
+    for (i = 0; i < 256; i++) {
+        bytes[i][0] = 'x';
+        bytes[i][1] = 255 - i;
+        assert(!radix_tree_put(tree, bytes[i], 2, bytes[i], NULL, NULL));
+    }
+    assert(!radix_tree_put(tree, "x", 1, NULL, NULL, NULL));
+    for (i = 0; i < 256; i++) {
+        const void *value;
+        assert(radix_tree_get(tree, bytes[i], 2, &value));
+        assert(value == bytes[i]);
+    }
+    for (i = 0; i < 256; i += 2)
+        assert(radix_tree_pop(tree, bytes[i], 2, NULL, NULL));
+    for (i = 1; i < 256; i += 2)
+        assert(radix_tree_get(tree, bytes[i], 2, NULL));
+    for (i = 1; i < 256; i += 2)
+        assert(radix_tree_pop(tree, bytes[i], 2, NULL, NULL));
+    assert(radix_tree_size(tree) == 1);
+    const void *key;
+    size_t size;
+    assert(radix_tree_longest_prefix(tree, "xyz", 3, &key, &size, NULL));
+    assert(size == 1 && !memcmp(key, "x", 1));
+    destroy_radix_tree(tree);
+
+    /* Destroy a nonempty tree. */
+    tree = make_radix_tree();
+    for (i = 0; i < 256; i++)
+        radix_tree_put(tree, bytes[i], 1 + i % 2, NULL, NULL, NULL);
+    radix_tree_put(tree, "", 0, NULL, NULL, NULL);
+    destroy_radix_tree(tree);
+}
+
+int main()
+{
+    test_fanout();
+    test_random();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <fsdyn/priority_queue.h>
+#include <fsdyn/timerwheel.h>
+
+enum {
+    N = 1000000,     /* active timers */
+    SPAN = 1000000,  /* timeouts are up to SPAN ticks */
+    TICKS = 2000000, /* simulated ticks */
+};
+
+/* A connection timer that is refreshed now and then and rescheduled
+ * when it expires. */
+typedef struct {
+    uint64_t expiry;
+    void *loc;
+    timer_wheel_elem_t *element;
+} entry_t;
+
+static entry_t timers[N];
+
+static int cmp(const void *value1, const void *value2)
+{
+    uint64_t e1 = ((const entry_t *) value1)->expiry;
+    uint64_t e2 = ((const entry_t *) value2)->expiry;
+    return e1 < e2 ? -1 : e1 > e2;
+}
+
+static void reloc(const void *value, void *loc)
+{
+    ((entry_t *) value)->loc = loc;
+}
+
+uint64_t now_ns()
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_usec * 1000;
+}
+
+static void expire_timer(const void *value, void *arg)
+{
+    entry_t *timer = (entry_t *) value;
+    timer_wheel_t *wheel = arg;
+    timer->expiry = timer_wheel_now(wheel) + 1 + random() % SPAN;
+    timer->element = timer_wheel_schedule(wheel, timer->expiry, timer);
+}
+
+static void measure_timer_wheel(void)
+{
+    fprintf(stderr, "measure timer wheel\n");
+    srandom(1);
+    uint64_t start = now_ns();
+    timer_wheel_t *wheel = make_timer_wheel(0);
+    int i;
+    for (i = 0; i < N; i++) {
+        timers[i].expiry = 1 + random() % SPAN;
+        timers[i].element =
+            timer_wheel_schedule(wheel, timers[i].expiry, &timers[i]);
+    }
+    uint64_t middle = now_ns();
+    size_t expired = 0;
+    uint64_t tick;
+    for (tick = 1; tick <= TICKS; tick++) {
+        entry_t *timer = &timers[random() % N];
+        timer_wheel_cancel(wheel, timer->element);
+        timer->expiry = tick + random() % SPAN;
+        timer->element = timer_wheel_schedule(wheel, timer->expiry, timer);
+        expired += timer_wheel_advance(wheel, tick, expire_timer, wheel);
+    }
+    uint64_t finish = now_ns();
+    destroy_timer_wheel(wheel);
+    fprintf(stderr, "  schedule %g s, run %g s (%zu expired)\n",
+            (middle - start) * 1e-9, (finish - middle) * 1e-9, expired);
+}
+
+static void measure_priority_queue(void)
+{
+    fprintf(stderr, "measure priority queue\n");
+    srandom(1);
+    uint64_t start = now_ns();
+    priorq_t *prq = make_priority_queue(cmp, reloc);
+    int i;
+    for (i = 0; i < N; i++) {
+        timers[i].expiry = 1 + random() % SPAN;
+        priorq_enqueue(prq, &timers[i]);
+    }
+    uint64_t middle = now_ns();
+    size_t expired = 0;
+    uint64_t tick;
+    for (tick = 1; tick <= TICKS; tick++) {
+        entry_t *timer = &timers[random() % N];
+        timer->expiry = tick + random() % SPAN;
+        priorq_update(prq, timer->loc);
+        const entry_t *first;
+        while ((first = priorq_peek(prq)) && first->expiry <= tick) {
+            timer = (entry_t *) priorq_dequeue(prq);
+            timer->expiry = tick + 1 + random() % SPAN;
+            priorq_enqueue(prq, timer);
+            expired++;
+        }
+    }
+    uint64_t finish = now_ns();
+    destroy_priority_queue(prq);
+    fprintf(stderr, "  schedule %g s, run %g s (%zu expired)\n",
+            (middle - start) * 1e-9, (finish - middle) * 1e-9, expired);
+}
+
+int main()
+{
+    measure_timer_wheel();
+    measure_priority_queue();
+    return EXIT_SUCCESS;
+}
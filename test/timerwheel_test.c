@@ -0,0 +1,203 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fsdyn/timerwheel.h>
+
+enum {
+    N = 2000,
+    ROUNDS = 20000,
+};
+
+typedef struct {
+    uint64_t expiry;
+    uint64_t scheduled; /* the time of the wheel when scheduled */
+    timer_wheel_elem_t *element;
+} entry_t;
+
+static entry_t timers[N];
+
+static uint64_t random64(void)
+{
+    return (uint64_t) random() << 42 ^ (uint64_t) random() << 21 ^ random();
+}
+
+/* Mix delays of all magnitudes, including ones in the past. */
+static uint64_t random_expiry(uint64_t now)
+{
+    switch (random() % 6) {
+        case 0:
+            return now - random() % 100;
+        case 1:
+            return now + random() % 64;
+        case 2:
+            return now + random() % 5000;
+        case 3:
+            return now + (random64() >> (random() % 64));
+        case 4:
+            return UINT64_MAX - random() % 3;
+        default:
+            return now + random() % 1000000;
+    }
+}
+
+static void schedule(timer_wheel_t *wheel, entry_t *timer)
+{
+    timer->scheduled = timer_wheel_now(wheel);
+    timer->expiry = random_expiry(timer->scheduled);
+    timer->element = timer_wheel_schedule(wheel, timer->expiry, timer);
+    assert(timer_wheel_elem_get_value(timer->element) == timer);
+    assert(timer_wheel_elem_get_expiry(timer->element) == timer->expiry);
+}
+
+static void cancel(timer_wheel_t *wheel, entry_t *timer)
+{
+    assert(timer_wheel_cancel(wheel, timer->element) == timer);
+    timer->element = NULL;
+}
+
+typedef struct {
+    timer_wheel_t *wheel;
+    uint64_t start, now, previous;
+    size_t count;
+    bool meddle;
+} advance_t;
+
+static void check_expired(const void *value, void *arg)
+{
+    advance_t *advance = arg;
+    entry_t *timer = (entry_t *) value;
+    assert(timer->element);
+    uint64_t tick = timer->expiry;
+    if (tick < timer->scheduled)
+        tick = timer->scheduled;
+    if (tick < advance->start)
+        tick = advance->start;
+    assert(tick <= advance->now);
+    assert(tick >= advance->previous);
+    advance->previous = tick;
+    timer->element = NULL;
+    advance->count++;
+    if (advance->meddle) {
+        /* Reschedule the timer and cancel another one. */
+        schedule(advance->wheel, timer);
+        entry_t *other = &timers[random() % N];
+        if (other->element)
+            cancel(advance->wheel, other);
+    }
+}
+
+static void verify(timer_wheel_t *wheel)
+{
+    size_t size = 0;
+    bool found = false;
+    uint64_t first = 0;
+    int i;
+    for (i = 0; i < N; i++)
+        if (timers[i].element) {
+            if (!found || timers[i].expiry < first)
+                first = timers[i].expiry;
+            found = true;
+            size++;
+        }
+    assert(timer_wheel_size(wheel) == size);
+    assert(timer_wheel_empty(wheel) == !size);
+    uint64_t expiry;
+    assert(timer_wheel_next_expiry(wheel, &expiry) == found);
+    if (found)
+        assert(expiry == first);
+}
+
+static void advance(timer_wheel_t *wheel, uint64_t now, bool meddle)
+{
+    advance_t advance = {
+        .wheel = wheel,
+        .start = timer_wheel_now(wheel),
+        .now = now < timer_wheel_now(wheel) ? timer_wheel_now(wheel) : now,
+        .meddle = meddle,
+    };
+    size_t expected = 0;
+    int i;
+    if (!meddle)
+        for (i = 0; i < N; i++)
+            if (timers[i].element && timers[i].expiry <= advance.now)
+                expected++;
+    size_t count = timer_wheel_advance(wheel, now, check_expired, &advance);
+    assert(count == advance.count);
+    assert(meddle || count == expected);
+    assert(timer_wheel_now(wheel) == advance.now);
+    /* Nothing due may be left behind unless cb() scheduled it. */
+    if (!meddle)
+        for (i = 0; i < N; i++)
+            assert(!timers[i].element || timers[i].expiry > advance.now);
+}
+
+static uint64_t random_step(void)
+{
+    switch (random() % 5) {
+        case 0:
+            return 0;
+        case 1:
+            return random() % 64;
+        case 2:
+            return random() % 100000;
+        case 3:
+            return random64() >> (random() % 64);
+        default:
+            return random() % 1000;
+    }
+}
+
+static void test_random(uint64_t start)
+{
+    timer_wheel_t *wheel = make_timer_wheel(start);
+    assert(timer_wheel_now(wheel) == start);
+    verify(wheel);
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        entry_t *timer = &timers[random() % N];
+        switch (random() % 4) {
+            case 0:
+                if (timer->element)
+                    cancel(wheel, timer);
+                else
+                    schedule(wheel, timer);
+                break;
+            case 1: {
+                uint64_t now = timer_wheel_now(wheel), step = random_step();
+                if (random() % 10 == 0)
+                    now -= step;
+                else if (step > UINT64_MAX - now)
+                    now = UINT64_MAX;
+                else
+                    now += step;
+                advance(wheel, now, random() % 4 == 0);
+                break;
+            }
+            default:
+                if (!timer->element)
+                    schedule(wheel, timer);
+        }
+        if (round % 100 == 0)
+            verify(wheel);
+    }
+    verify(wheel);
+    advance(wheel, UINT64_MAX, false);
+    assert(timer_wheel_empty(wheel));
+    int i;
+    for (i = 0; i < N; i++)
+        if (random() % 2)
+            schedule(wheel, &timers[i]);
+    destroy_timer_wheel(wheel);
+    for (i = 0; i < N; i++)
+        timers[i].element = NULL;
+}
+
+int main()
+{
+    test_random(0);
+    test_random(1000);
+    test_random(UINT64_MAX - 100000000);
+    return EXIT_SUCCESS;
+}